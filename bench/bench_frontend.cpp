@@ -0,0 +1,337 @@
+// Front-end throughput benchmark: lexes and parses synthetic corpora of several shapes and sizes, loads them
+// back from a parse cache and reparses them incrementally after an edit, and reports tokens/s, MB/s, AST
+// nodes/s and peak heap usage.
+//
+// Usage: marbl_bench_frontend [max size in MiB, default 8]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <malloc.h>
+
+#include "ast.hpp"
+#include "flat_ast.hpp"
+#include "incremental.hpp"
+#include "lexer.hpp"
+#include "parse_cache.hpp"
+#include "parser.hpp"
+#include "program.hpp"
+#include "source.hpp"
+#include "tokens.hpp"
+
+// ======= Heap accounting =======
+// Every allocation goes through these, so a measurement can report its peak heap usage.
+
+namespace {
+std::atomic<size_t> liveBytes{0};
+std::atomic<size_t> peakBytes{0};
+
+void *allocate(size_t size) {
+    void *ptr = std::malloc(size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+
+    size_t live = liveBytes.fetch_add(malloc_usable_size(ptr)) + malloc_usable_size(ptr);
+    size_t peak = peakBytes.load();
+    while (live > peak && !peakBytes.compare_exchange_weak(peak, live)) {}
+    return ptr;
+}
+
+void deallocate(void *ptr) {
+    if (!ptr) return;
+    liveBytes.fetch_sub(malloc_usable_size(ptr));
+    std::free(ptr);
+}
+} // namespace
+
+void *operator new(size_t size) { return allocate(size); }
+void *operator new[](size_t size) { return allocate(size); }
+void operator delete(void *ptr) noexcept { deallocate(ptr); }
+void operator delete[](void *ptr) noexcept { deallocate(ptr); }
+void operator delete(void *ptr, size_t) noexcept { deallocate(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { deallocate(ptr); }
+
+namespace {
+// ======= Corpora =======
+
+std::string deepExpressions(size_t bytes) {
+    static const char *ops[] = {"+", "-", "*", "/", "<", "==", "and", "or"};
+    std::string out;
+    for (size_t n = 0; out.size() < bytes; n++) {
+        std::string expr = "x" + std::to_string(n % 97);
+        for (int depth = 0; depth < 24; depth++) {
+            std::string operand = depth % 3 == 0 ? std::to_string(depth) : "f(y" + std::to_string(depth) + ")";
+            expr = "(" + expr + " " + ops[(n + depth) % 8] + " " + operand + ")";
+            if (depth % 5 == 0) expr = "-" + expr;
+        }
+        out += "let v" + std::to_string(n) + " = " + expr + ";\n";
+    }
+    return out;
+}
+
+std::string smallFunctions(size_t bytes) {
+    std::string out;
+    for (size_t n = 0; out.size() < bytes; n++) {
+        std::string id = std::to_string(n);
+        out += "fn f" + id + "(a, b) {\n";
+        out += "    let c = a + b * " + id + ";\n";
+        out += "    if (c > 10) { print c; } else { print a; }\n";
+        out += "    while (c < 100) { c = c + 1; }\n";
+        out += "}\n";
+        out += "f" + id + "(1, 2);\n";
+    }
+    return out;
+}
+
+std::string longStrings(size_t bytes) {
+    std::string out;
+    for (size_t n = 0; out.size() < bytes; n++) {
+        std::string text;
+        for (size_t i = 0; i < 1024; i++) text += static_cast<char>('a' + (n + i) % 26);
+        if (n % 4 == 0) text += "\\n\\t\\\"escaped\\\"";
+        out += "print \"" + text + "\";\n";
+    }
+    return out;
+}
+
+std::string commentHeavy(size_t bytes) {
+    std::string out;
+    for (size_t n = 0; out.size() < bytes; n++) {
+        for (int i = 0; i < 8; i++) {
+            out += "// Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor " +
+                   std::to_string(n) + "\n";
+        }
+        out += "let a" + std::to_string(n) + " = " + std::to_string(n) + "; // trailing comment\n";
+    }
+    return out;
+}
+
+// Machine-generated-looking input where every other statement has a syntax error
+std::string syntaxErrors(size_t bytes) {
+    static const char *broken[] = {"let = 1;", "print (a + ;", "x = = y;", "f(1, 2;", "if (a { print a; }",
+                                   "1 + 2 = 3;"};
+    std::string out;
+    for (size_t n = 0; out.size() < bytes; n++) {
+        out += "let ok" + std::to_string(n) + " = a * " + std::to_string(n) + ";\n";
+        out += std::string(broken[n % 6]) + "\n";
+    }
+    return out;
+}
+
+// ======= Measurements =======
+
+// Walks a parsed program to count its nodes
+class NodeCounter {
+  public:
+    size_t count = 0;
+
+    void countAll(Program &program) {
+        for (auto &stmt : program.statements) {
+            if (stmt) stmt->accept(*this);
+        }
+    }
+
+  private:
+    friend class ::Expr;
+    friend class ::Stmt;
+
+    void visit(ExprPtr expr) {
+        if (expr) expr->accept(*this);
+    }
+    void visit(StmtPtr stmt) {
+        if (stmt) stmt->accept(*this);
+    }
+
+    void visitBinaryExpr(Binary &expr) {
+        count++;
+        visit(expr.left);
+        visit(expr.right);
+    }
+    void visitGroupingExpr(Grouping &expr) {
+        count++;
+        visit(expr.expression);
+    }
+    void visitLiteralExpr(Literal &) { count++; }
+    void visitUnaryExpr(Unary &expr) {
+        count++;
+        visit(expr.right);
+    }
+    void visitVariableExpr(Variable &) { count++; }
+    void visitAssignExpr(Assign &expr) {
+        count++;
+        visit(expr.value);
+    }
+    void visitLogicalExpr(Logical &expr) {
+        count++;
+        visit(expr.left);
+        visit(expr.right);
+    }
+    void visitCallExpr(Call &expr) {
+        count++;
+        visit(expr.callee);
+        for (auto &arg : expr.arguments) visit(arg);
+    }
+    void visitTypeAnnotationExpr(TypeAnnotation &) { count++; }
+
+    void visitExpressionStmt(Expression &stmt) {
+        count++;
+        visit(stmt.expression);
+    }
+    void visitPrintStmt(Print &stmt) {
+        count++;
+        visit(stmt.expression);
+    }
+    void visitLetStmt(Let &stmt) {
+        count++;
+        visit(stmt.annotation);
+        visit(stmt.initializer);
+    }
+    void visitBlockStmt(Block &stmt) {
+        count++;
+        for (auto &sub : stmt.statements) visit(sub);
+    }
+    void visitIfStmt(If &stmt) {
+        count++;
+        visit(stmt.condition);
+        visit(stmt.thenBranch);
+        visit(stmt.elseBranch);
+    }
+    void visitWhileStmt(While &stmt) {
+        count++;
+        visit(stmt.condition);
+        visit(stmt.body);
+    }
+    void visitFunctionStmt(Function &stmt) {
+        count++;
+        for (auto &param : stmt.params) visitLetStmt(param);
+        visit(stmt.returnAnnotation);
+        for (auto &sub : stmt.body) visit(sub);
+    }
+    void visitClassStmt(Class &) { count++; }
+    void visitReturnStmt(Return &stmt) {
+        count++;
+        visit(stmt.value);
+    }
+};
+
+struct Result {
+    double seconds;
+    size_t peakHeap;
+};
+
+constexpr int ITERATIONS = 3;
+
+// Best of ITERATIONS runs, with the peak heap measured relative to what was live before each run
+Result measure(const std::function<void()> &run) {
+    Result best{1e300, 0};
+    for (int i = 0; i < ITERATIONS; i++) {
+        size_t baseline = liveBytes.load();
+        peakBytes.store(baseline);
+
+        auto start = std::chrono::steady_clock::now();
+        run();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        best.seconds = std::min(best.seconds, elapsed.count());
+        best.peakHeap = std::max(best.peakHeap, peakBytes.load() - baseline);
+    }
+    return best;
+}
+
+void report(const char *corpus, size_t bytes, const char *phase, const Result &result, size_t tokens,
+            size_t nodes) {
+    double mb = bytes / (1024.0 * 1024.0);
+    std::printf("%-16s %8.2f %-16s %10.1f %12.0f %12s %10.0f\n", corpus, mb, phase, mb / result.seconds,
+                tokens / result.seconds,
+                nodes ? std::to_string(static_cast<size_t>(nodes / result.seconds)).c_str() : "-",
+                result.peakHeap / 1024.0);
+}
+
+std::filesystem::path cacheDirectory() {
+    return std::filesystem::temp_directory_path() / "marbl_bench_cache";
+}
+
+void bench(const char *corpus, const std::string &text) {
+    FileId file = Sources::add(corpus, text);
+
+    size_t tokens = 0;
+    Result lex = measure([&] {
+        Lexer lexer{file};
+        tokens = 0;
+        while (lexer.nextToken() != TokenType::T_EOF) tokens++;
+    });
+    report(corpus, text.size(), "lex", lex, tokens, 0);
+
+    NodeCounter counter;
+    {
+        Parser parser{file};
+        Program program = parser.parse();
+        counter.countAll(program);
+    }
+
+    for (LexMode mode : {LexMode::Pull, LexMode::Prelexed}) {
+        Result parse = measure([&] {
+            Parser parser{file, mode};
+            Program program = parser.parse();
+        });
+        report(corpus, text.size(), mode == LexMode::Pull ? "parse (pull)" : "parse (prelexed)", parse,
+               tokens, counter.count);
+    }
+
+    // The cost of serializing for the parse cache. Peak heap of this phase is the size of the flat AST, which
+    // comes on top of the pointer AST it is built from.
+    Parser parser{file};
+    Program program = parser.parse();
+    Result flatten = measure([&] { FlatAst flat = FlatAst::build(program); });
+    report(corpus, text.size(), "flatten", flatten, tokens, counter.count);
+
+    ParseCache cache{cacheDirectory()};
+    cache.store(file, program);
+    Result load = measure([&] { std::optional<Program> cached = cache.load(file); });
+    report(corpus, text.size(), "cache load", load, tokens, counter.count);
+
+    // An editor inserting a line in the middle of the file and deleting it again, each followed by a reparse.
+    // Throughput is that of a full parse taking as long as the two edits.
+    IncrementalParser incremental{file};
+    size_t middle = text.find('\n', text.size() / 2) + 1;
+    std::string line = "let edited = 1;\n";
+    Result edit = measure([&] {
+        incremental.apply(TextEdit{middle, middle, line});
+        incremental.apply(TextEdit{middle, middle + line.size(), ""});
+    });
+    report(corpus, text.size(), "edit (2x)", edit, tokens, counter.count);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+    size_t maxMiB = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 8;
+
+    struct Shape {
+        const char *name;
+        std::string (*generate)(size_t);
+    };
+    const Shape shapes[] = {
+        {"deep-expr", deepExpressions},
+        {"small-functions", smallFunctions},
+        {"long-strings", longStrings},
+        {"comments", commentHeavy},
+        {"syntax-errors", syntaxErrors},
+    };
+
+    std::printf("%-16s %8s %-16s %10s %12s %12s %10s\n", "corpus", "MiB", "phase", "MiB/s", "tokens/s",
+                "nodes/s", "peak KiB");
+
+    for (size_t kib = 64; kib <= maxMiB * 1024; kib *= 8) {
+        for (const Shape &shape : shapes) bench(shape.name, shape.generate(kib * 1024));
+    }
+
+    std::filesystem::remove_all(cacheDirectory());
+    return 0;
+}
@@ -1,9 +1,8 @@
 #!/bin/sh
 # rm -rf build
-rm build/output.o build/program.out
+rm -f build/program.out
 ./build.sh
 
-./build/marbl_app examples/hello.mrbl
-g++ build/output.o -o build/program.out
+./build/marbl_app -O2 --emit=exe -o build/program.out examples/hello.mrbl
 ./build/program.out
 echo "exit code: $?"
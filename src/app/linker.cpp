@@ -0,0 +1,171 @@
+#include "linker.hpp"
+
+#include <optional>
+#include <vector>
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FileUtilities.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Program.h"
+#include "llvm/TargetParser/Host.h"
+
+#ifdef MARBL_HAVE_LLD
+#include <mutex>
+
+#include "lld/Common/Driver.h"
+
+LLD_HAS_DRIVER(elf)
+#endif
+
+namespace {
+// The system's linker and C compiler driver only know about the host
+bool isHost(const llvm::Triple &triple) {
+    llvm::Triple host(llvm::sys::getProcessTriple());
+    return triple.getArch() == host.getArch() && triple.getOS() == host.getOS() &&
+           triple.getEnvironment() == host.getEnvironment();
+}
+
+// Where the C runtime of a target lives
+struct Runtime {
+    std::string scrt1, crti, crtn;
+    std::string libDir; // Holds libc
+    std::string dynamicLinker;
+};
+
+// Whether `dir` has the startup files and libc, which glibc installs side by side
+bool holdsRuntime(const std::string &dir) {
+    for (const char *file : {"/Scrt1.o", "/crti.o", "/crtn.o", "/libc.so"}) {
+        if (!llvm::sys::fs::exists(dir + file)) return false;
+    }
+    return true;
+}
+
+// The directory of the Scrt1.o the system's C compiler driver (cc) would link with, from a single
+// `cc -print-file-name=Scrt1.o`. nullopt when there is no cc or it does not know the file, in which case it
+// prints the name unchanged.
+std::optional<std::string> askDriver() {
+    llvm::ErrorOr<std::string> driver = llvm::sys::findProgramByName("cc");
+    if (!driver) return std::nullopt;
+
+    llvm::SmallString<128> captured;
+    if (llvm::sys::fs::createTemporaryFile("marbl-cc", "txt", captured)) return std::nullopt;
+    llvm::FileRemover remover(captured);
+
+    llvm::StringRef argv[] = {"cc", "-print-file-name=Scrt1.o"};
+    std::optional<llvm::StringRef> redirects[] = {std::nullopt, llvm::StringRef(captured), std::nullopt};
+    if (llvm::sys::ExecuteAndWait(*driver, argv, std::nullopt, redirects) != 0) return std::nullopt;
+
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> output = llvm::MemoryBuffer::getFile(captured);
+    if (!output) return std::nullopt;
+    std::string path = (*output)->getBuffer().trim().str();
+    if (!llvm::sys::path::is_absolute(path) || !llvm::sys::fs::exists(path)) return std::nullopt;
+    return llvm::sys::path::parent_path(path).str();
+}
+
+std::optional<Runtime> findRuntime(const llvm::Triple &triple, llvm::raw_ostream &err) {
+    if (!triple.isOSLinux()) {
+        err << "error: linking executables is not supported for '" << triple.str() << "'\n";
+        return std::nullopt;
+    }
+
+    // The path the architecture's ELF ABI fixes, which is the same on every distribution using glibc
+    std::string dynamicLinker;
+    switch (triple.getArch()) {
+    case llvm::Triple::x86_64: dynamicLinker = "/lib64/ld-linux-x86-64.so.2"; break;
+    case llvm::Triple::aarch64: dynamicLinker = "/lib/ld-linux-aarch64.so.1"; break;
+    default:
+        err << "error: no known dynamic linker for '" << triple.str() << "'\n";
+        return std::nullopt;
+    }
+
+    // The usual locations: multiarch (Debian, Ubuntu) and its cross-compilation layout, then for the host the
+    // layouts of distributions without multiarch. Only when none has it, the C compiler is asked.
+    std::string arch = triple.getArchName().str();
+    std::vector<std::string> dirs = {"/usr/lib/" + arch + "-linux-gnu", "/usr/" + arch + "-linux-gnu/lib"};
+    if (isHost(triple)) {
+        dirs.push_back("/usr/lib64");
+        dirs.push_back("/usr/lib");
+    }
+    std::optional<std::string> dir;
+    for (const std::string &candidate : dirs) {
+        if (holdsRuntime(candidate)) {
+            dir = candidate;
+            break;
+        }
+    }
+    if (!dir && isHost(triple)) dir = askDriver();
+
+    if (!dir || !holdsRuntime(*dir)) {
+        err << "error: cannot find the C runtime (Scrt1.o, crti.o, crtn.o, libc.so) for '" << triple.str()
+            << "'\n";
+        return std::nullopt;
+    }
+    return Runtime{*dir + "/Scrt1.o", *dir + "/crti.o", *dir + "/crtn.o", *dir, dynamicLinker};
+}
+} // namespace
+
+bool Linker::link(const std::string &object, const std::string &output, const llvm::Triple &triple,
+                  llvm::raw_ostream &err) {
+#ifndef MARBL_HAVE_LLD
+    if (!isHost(triple)) {
+        err << "error: linking executables for '" << triple.str()
+            << "' needs a build with the embedded LLD (MARBL_USE_LLD)\n";
+        return false;
+    }
+#endif
+
+    // Found once: every executable is linked against the same C runtime
+    static std::string runtimeErrors;
+    static std::optional<Runtime> runtime = [&] {
+        llvm::raw_string_ostream errors(runtimeErrors);
+        return findRuntime(triple, errors);
+    }();
+    if (!runtime) {
+        err << runtimeErrors;
+        return false;
+    }
+
+    // What a C compiler driver would pass, minus its own runtime, which Marbl programs do not need
+    std::vector<std::string> args = {
+        "ld", "-pie", "--eh-frame-hdr", "-dynamic-linker", runtime->dynamicLinker, "-o", output,
+        runtime->scrt1, runtime->crti, object, "-L" + runtime->libDir, "-lc", runtime->crtn,
+    };
+
+#ifdef MARBL_HAVE_LLD
+    // LLD keeps global state, so the files compiled on other threads link one at a time. After some failures
+    // that state cannot be reset, and LLD must not run again in this process.
+    static std::mutex mutex;
+    static bool unusable = false;
+    std::lock_guard lock(mutex);
+    if (unusable) {
+        err << "error: cannot link '" << output << "': the embedded LLD cannot run again after an earlier "
+            << "failure\n";
+        return false;
+    }
+
+    args[0] = "ld.lld";
+    std::vector<const char *> argv;
+    for (const std::string &arg : args) argv.push_back(arg.c_str());
+
+    lld::Result result = lld::lldMain(argv, llvm::nulls(), err, {{lld::Gnu, &lld::elf::link}});
+    if (!result.canRunAgain) unusable = true;
+    return result.retCode == 0;
+#else
+    // Out of process, by running the system's linker directly
+    llvm::ErrorOr<std::string> linker = llvm::sys::findProgramByName("ld");
+    if (!linker) {
+        err << "error: cannot find a linker (ld) to link with, and this build has no embedded LLD\n";
+        return false;
+    }
+
+    std::vector<llvm::StringRef> argv(args.begin(), args.end());
+    std::string message;
+    int status = llvm::sys::ExecuteAndWait(*linker, argv, std::nullopt, {}, 0, 0, &message);
+    if (status != 0) {
+        err << "error: linking '" << output << "' failed" << (message.empty() ? "" : ": " + message) << "\n";
+        return false;
+    }
+    return true;
+#endif
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/TargetParser/Triple.h"
+
+// Links an object file against the C library into a dynamically linked, position-independent executable.
+//
+// The C runtime's startup files and libc are looked for in the usual Linux locations for the target, and
+// only for the host, if none has them, where the system's C compiler driver (cc) finds them. The dynamic
+// linker is the one the ELF ABI names, so only Linux targets are supported.
+//
+// With LLD found at build time (MARBL_HAVE_LLD), linking is in-process. Without it, the system's linker (ld)
+// is run directly, which only works for the host.
+namespace Linker {
+// Reports what went wrong to `err` and returns false when the executable could not be linked
+bool link(const std::string &object, const std::string &output, const llvm::Triple &triple,
+          llvm::raw_ostream &err);
+} // namespace Linker
@@ -1,94 +1,416 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
 #include <iostream>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
 
 #include "ast.hpp"
+#include "constant_folder.hpp"
+#include "dead_code_eliminator.hpp"
+#include "errors.hpp"
+#include "linker.hpp"
 #include "llvm_codegen.hpp"
 #include "marbl.hpp"
+#include "options.hpp"
+#include "parse_cache.hpp"
 #include "parser.hpp"
 #include "printer.hpp"
+#include "program.hpp"
+#include "resolver.hpp"
+#include "source.hpp"
+#include "type_checker.hpp"
 
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/MC/MCSubtargetInfo.h"
 #include "llvm/MC/TargetRegistry.h"
+#include "llvm/Passes/OptimizationLevel.h"
+#include "llvm/Passes/PassBuilder.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FileUtilities.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_os_ostream.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/TargetParser/Host.h"
+#include "llvm/TargetParser/SubtargetFeature.h"
 #include <llvm/IR/LegacyPassManager.h>
 
-int compile(std::vector<UniqueStmt> &statements, std::string filename) {
-    for (auto &statement : statements) {
-        AstPrinter printer{};
-        printer.print(*statement);
+namespace {
+// What compiling one file printed, kept until every file is done so the outputs do not interleave
+struct Result {
+    int status = EX_OK;
+    std::string out;
+    std::string err;
+};
+
+// Os and Oz optimize for speed like O2, and only differ from it in the IR pipeline
+llvm::CodeGenOptLevel codeGenOptLevel(const llvm::OptimizationLevel &level) {
+    switch (level.getSpeedupLevel()) {
+    case 0: return llvm::CodeGenOptLevel::None;
+    case 1: return llvm::CodeGenOptLevel::Less;
+    case 3: return llvm::CodeGenOptLevel::Aggressive;
+    default: return llvm::CodeGenOptLevel::Default;
     }
+}
 
-    // Generate IR
-    CodeGenVisitor codegen(filename);
-    codegen.generate(statements);
+// Without -o, outputs go to build/<stem> with the extension of what is emitted, so two inputs with the same
+// stem would overwrite each other
+std::string outputPath(const std::string &input, const Options &options) {
+    if (options.output) return *options.output;
 
-    // Print IR to stdout
-    std::cout << "Generated LLVM IR:\n";
-    codegen.getModule().print(llvm::outs(), nullptr);
+    std::string path = "build/" + std::filesystem::path(input).stem().string();
+    switch (options.emit) {
+    case Emit::Obj: return path + ".o";
+    case Emit::Exe: return path;
+    case Emit::Asm: return path + ".s";
+    case Emit::Bc: return path + ".bc";
+    case Emit::Ll: return path + ".ll";
+    }
+    std::unreachable();
+}
 
-    // Initialize LLVM targets
-    llvm::InitializeNativeTarget();
-    llvm::InitializeNativeTargetAsmPrinter();
-    llvm::InitializeNativeTargetAsmParser();
+std::string_view describe(Emit emit) {
+    switch (emit) {
+    case Emit::Obj: return "Object file";
+    case Emit::Exe: return "Executable";
+    case Emit::Asm: return "Assembly file";
+    case Emit::Bc: return "Bitcode file";
+    case Emit::Ll: return "IR file";
+    }
+    std::unreachable();
+}
 
-    // Create target machine
-    auto targetTriple = llvm::sys::getDefaultTargetTriple();
-    std::string error;
-    auto *target = llvm::TargetRegistry::lookupTarget(targetTriple, error);
+// Writes the module straight into `dest`, as IR, bitcode, assembly or an object file
+bool write(llvm::Module &module, llvm::TargetMachine &targetMachine, Emit emit, llvm::raw_pwrite_stream &dest,
+           llvm::raw_ostream &err) {
+    if (emit == Emit::Ll) {
+        module.print(dest, nullptr);
+        return true;
+    }
+    if (emit == Emit::Bc) {
+        llvm::WriteBitcodeToFile(module, dest);
+        return true;
+    }
 
-    if (!target) {
-        llvm::errs() << "Failed to lookup target: " << error << "\n";
-        return 1;
+    llvm::legacy::PassManager pass;
+    llvm::CodeGenFileType type =
+        emit == Emit::Asm ? llvm::CodeGenFileType::AssemblyFile : llvm::CodeGenFileType::ObjectFile;
+    if (targetMachine.addPassesToEmitFile(pass, dest, nullptr, type)) {
+        err << "TargetMachine can't emit " << (emit == Emit::Asm ? "assembly" : "an object file") << "\n";
+        return false;
+    }
+    pass.run(module);
+    return true;
+}
+
+// Runs the same module pipeline as clang at the given level. Codegen leaves every local in an alloca, so even
+// -O1 makes a large difference through mem2reg and inlining.
+void optimize(llvm::Module &module, llvm::TargetMachine &targetMachine, llvm::OptimizationLevel level) {
+    if (level == llvm::OptimizationLevel::O0) return;
+
+    llvm::LoopAnalysisManager loopAnalyses;
+    llvm::FunctionAnalysisManager functionAnalyses;
+    llvm::CGSCCAnalysisManager cgsccAnalyses;
+    llvm::ModuleAnalysisManager moduleAnalyses;
+
+    llvm::PassBuilder passBuilder(&targetMachine);
+    passBuilder.registerModuleAnalyses(moduleAnalyses);
+    passBuilder.registerCGSCCAnalyses(cgsccAnalyses);
+    passBuilder.registerFunctionAnalyses(functionAnalyses);
+    passBuilder.registerLoopAnalyses(loopAnalyses);
+    passBuilder.crossRegisterProxies(loopAnalyses, functionAnalyses, cgsccAnalyses, moduleAnalyses);
+
+    llvm::ModulePassManager passes = passBuilder.buildPerModuleDefaultPipeline(level);
+    passes.run(module, moduleAnalyses);
+}
+
+// The features of the host CPU, in the form of --features. Features given on the command line come after
+// them, and so override them.
+std::string hostFeatures() {
+    llvm::StringMap<bool> features;
+    llvm::sys::getHostCPUFeatures(features);
+
+    std::string list;
+    for (const auto &feature : features) {
+        if (!list.empty()) list += ',';
+        list += feature.second ? '+' : '-';
+        list += feature.first();
     }
+    return list;
+}
+
+// Passes read the CPU from the function rather than the TargetMachine: without these attributes, the
+// vectorizers cost every function as if for a generic CPU
+void addTargetAttributes(llvm::Module &module, const Options &options) {
+    for (llvm::Function &function : module) {
+        if (function.isDeclaration()) continue;
+        function.addFnAttr("target-cpu", options.cpu);
+        if (!options.features.empty()) function.addFnAttr("target-features", options.features);
+    }
+}
+
+// Compiles the module in memory and calls its main, as running the linked executable would. printf and clock
+// are those of this process.
+//
+// Returns the program's exit status, or EX_SOFTWARE when the JIT fails. Marbl programs cannot exit with a
+// status of their own: the generated main always returns 0 (top-level code cannot return), so any other
+// status of `marbl run` comes from marbl and was explained on stderr. Should programs ever get to choose
+// their status, a JIT failure would have to be told apart differently.
+int run(llvm::orc::ThreadSafeModule module, const Options &options, const std::string &targetTriple,
+        llvm::raw_ostream &err) {
+    llvm::orc::JITTargetMachineBuilder machine{llvm::Triple(targetTriple)};
+    machine.setCPU(options.cpu);
+    machine.addFeatures(llvm::SubtargetFeatures(options.features).getFeatures());
+    machine.setCodeGenOptLevel(codeGenOptLevel(options.optLevel));
+
+    auto fail = [&](llvm::Error error) {
+        err << "error: " << llvm::toString(std::move(error)) << "\n";
+        return EX_SOFTWARE;
+    };
 
+    llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> jit =
+        llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(std::move(machine)).create();
+    if (!jit) return fail(jit.takeError());
+
+    auto host = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        (*jit)->getDataLayout().getGlobalPrefix());
+    if (!host) return fail(host.takeError());
+    (*jit)->getMainJITDylib().addGenerator(std::move(*host));
+
+    if (llvm::Error error = (*jit)->addIRModule(std::move(module))) return fail(std::move(error));
+
+    llvm::Expected<llvm::orc::ExecutorAddr> main = (*jit)->lookup("main");
+    if (!main) return fail(main.takeError());
+
+    int status = main->toPtr<int (*)()>()();
+    std::fflush(stdout);
+    return status;
+}
+
+int compile(Program &program, const std::string &filename, const Options &options, const llvm::Target &target,
+            const std::string &targetTriple, std::ostringstream &out, llvm::raw_ostream &err) {
+    // Generate IR. Every file gets its own visitor and so its own LLVMContext, which is what lets files be
+    // compiled on separate threads.
+    CodeGenVisitor codegen(filename);
+    codegen.generate(program);
+
+    // A TargetMachine is not shared between threads either
     llvm::TargetOptions opt;
     auto RM = std::optional<llvm::Reloc::Model>(llvm::Reloc::PIC_);
     std::unique_ptr<llvm::TargetMachine> targetMachine(
-        target->createTargetMachine(targetTriple, "generic", "", opt, RM));
+        target.createTargetMachine(targetTriple, options.cpu, options.features, opt, RM, std::nullopt,
+                                   codeGenOptLevel(options.optLevel)));
 
     codegen.getModule().setDataLayout(targetMachine->createDataLayout());
     codegen.getModule().setTargetTriple(targetTriple);
+    addTargetAttributes(codegen.getModule(), options);
 
-    // Emit object file
-    std::error_code EC;
-    llvm::raw_fd_ostream dest("build/output.o", EC, llvm::sys::fs::OF_None);
-    if (EC) {
-        llvm::errs() << "Could not open file: " << EC.message() << "\n";
-        return 1;
+#ifndef NDEBUG
+    // Invalid IR is a bug in codegen, which the passes below would only turn into a crash
+    if (llvm::verifyModule(codegen.getModule(), &err)) {
+        err << filename << ": error: codegen produced invalid IR\n";
+        return EX_SOFTWARE;
     }
+#endif
 
-    llvm::legacy::PassManager pass;
-    if (targetMachine->addPassesToEmitFile(pass, dest, nullptr, llvm::CodeGenFileType::ObjectFile)) {
-        llvm::errs() << "TargetMachine can't emit object file\n";
-        return 1;
+    optimize(codegen.getModule(), *targetMachine, options.optLevel);
+
+    if (options.emitIr) {
+        llvm::raw_os_ostream ir(out);
+        codegen.getModule().print(ir, nullptr);
+    }
+
+    if (options.run) {
+        // The program prints straight to stdout, so what was asked for before it has to come first
+        std::cout << out.str() << std::flush;
+        out.str("");
+        return run(codegen.takeModule(), options, targetTriple, err);
+    }
+
+    // An executable is linked from an object in a temporary file, which is removed afterwards
+    std::string output = outputPath(filename, options);
+    std::string written = output;
+    if (options.emit == Emit::Exe) {
+        llvm::SmallString<128> object;
+        if (std::error_code EC = llvm::sys::fs::createTemporaryFile("marbl", "o", object)) {
+            err << "Could not create a temporary file: " << EC.message() << "\n";
+            return EX_CANTCREAT;
+        }
+        written = object.str().str();
+    }
+    llvm::FileRemover removeObject(written, options.emit == Emit::Exe);
+
+    {
+        bool text = options.emit == Emit::Ll || options.emit == Emit::Asm;
+        std::error_code EC;
+        llvm::raw_fd_ostream dest(written, EC, text ? llvm::sys::fs::OF_Text : llvm::sys::fs::OF_None);
+        if (EC) {
+            err << "Could not open file: " << EC.message() << "\n";
+            return EX_CANTCREAT;
+        }
+        if (!write(codegen.getModule(), *targetMachine, options.emit, dest, err)) return EX_SOFTWARE;
+    }
+
+    if (options.emit == Emit::Exe) {
+        if (!Linker::link(written, output, llvm::Triple(targetTriple), err)) return EX_SOFTWARE;
+    }
+
+    // -o - writes to stdout, which the message would end up in
+    if (output != "-") out << describe(options.emit) << " '" << output << "' generated successfully!\n";
+    return EX_OK;
+}
+
+Result compileFile(const std::string &input, const Options &options, const ParseCache *cache,
+                   const llvm::Target &target, const std::string &targetTriple) {
+    Result result;
+    std::ostringstream out;
+    llvm::raw_string_ostream err(result.err);
+
+    std::optional<FileId> source = Sources::load(input);
+    if (!source) {
+        err << "Cannot open input file '" << input << "'!\n";
+        result.status = EX_NOINPUT;
+        return result;
+    }
+
+    auto fail = [&](const std::vector<Diagnostic> &diagnostics) {
+        std::ostringstream text;
+        Errors::print(text, diagnostics);
+        err << text.str();
+        result.status = EX_DATAERR;
+        result.out = out.str();
+        return result;
+    };
+
+    std::optional<Program> program = cache ? cache->load(*source) : std::nullopt;
+    if (!program) {
+        Parser parser{*source};
+        program = parser.parse();
+
+        if (parser.hadError()) return fail(parser.getDiagnostics());
+        if (cache) cache->store(*source, *program);
     }
 
-    pass.run(codegen.getModule());
-    dest.flush();
+    // The tree as parsed, before any pass rewrites it, so also for programs that do not resolve or type check
+    if (options.dumpAst) AstDump::print(out, *program, *options.dumpAst);
+
+    // Slots and types are not cached: both passes are cheap next to parsing, and codegen needs their results
+    // on the nodes
+    Resolver resolver;
+    resolver.resolve(*program);
+    if (resolver.hadError()) return fail(resolver.getDiagnostics());
+
+    TypeChecker checker;
+    checker.check(*program);
+    if (checker.hadError()) return fail(checker.getDiagnostics());
+
+    ConstantFolder folder;
+    folder.fold(*program);
+
+    DeadCodeEliminator eliminator;
+    eliminator.eliminate(*program);
+
+    try {
+        result.status = compile(*program, input, options, target, targetTriple, out, err);
+    } catch (const std::runtime_error &error) {
+        err << input << ": error: " << error.what() << "\n";
+        result.status = EX_DATAERR;
+    }
 
-    std::cout << "Object file 'build/output.o' generated successfully!\n";
-    return 0;
+    result.out = out.str();
+    return result;
 }
+} // namespace
 
 // We follow the conventions defined in UNIX "sysexits.h" header for exit codes:
 // (https://man.freebsd.org/cgi/man.cgi?query=sysexits&apropos=0&sektion=0&manpath=FreeBSD+4.3-RELEASE&format=html).
 int main(int argc, char **argv) {
-    std::ifstream inputFile(argv[1]);
+    // Without arguments, an interactive session
+    if (argc == 1) return Marbl::runPrompt();
 
-    if (!inputFile) {
-        std::cerr << "Cannot open input file!" << std::endl;
-        return EX_NOINPUT;
+    std::optional<Options> options = CommandLine::parse(argc, argv, std::cerr);
+    if (!options) {
+        CommandLine::usage(std::cerr, argv[0]);
+        return EX_USAGE;
     }
 
-    Parser parser{inputFile, std::string(argv[1])};
-    std::vector<UniqueStmt> statements = parser.parse();
+    std::set<std::string> outputs;
+    for (const std::string &input : options->inputs) {
+        if (!options->run && !outputs.insert(outputPath(input, *options)).second) {
+            std::cerr << "Two inputs would both be compiled to '" << outputPath(input, *options) << "'\n";
+            return EX_USAGE;
+        }
+    }
+
+    // Initialize LLVM targets, once for all files
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    llvm::InitializeNativeTargetAsmParser();
+
+    auto targetTriple = llvm::sys::getDefaultTargetTriple();
+    std::string error;
+    auto *target = llvm::TargetRegistry::lookupTarget(targetTriple, error);
+
+    if (!target) {
+        llvm::errs() << "Failed to lookup target: " << error << "\n";
+        return EX_SOFTWARE;
+    }
+
+    if (options->cpu == "native") {
+        std::string features = hostFeatures();
+        if (!options->features.empty()) features += (features.empty() ? "" : ",") + options->features;
+        options->cpu = llvm::sys::getHostCPUName().str();
+        options->features = std::move(features);
+    }
+
+    // Checked once here, as LLVM would otherwise only warn about it, for every file. The subtarget is created
+    // for the generic CPU, for which LLVM does not print that warning itself.
+    std::unique_ptr<llvm::MCSubtargetInfo> subtarget(target->createMCSubtargetInfo(targetTriple, "", ""));
+    if (!subtarget->isCPUStringValid(options->cpu)) {
+        std::cerr << "Unknown CPU '" << options->cpu << "' for target '" << targetTriple << "'\n";
+        return EX_USAGE;
+    }
 
-    inputFile.close();
+    std::optional<ParseCache> cache;
+    if (options->cacheDir) cache.emplace(*options->cacheDir);
+
+    // Workers take the next file from a shared counter, so a few large files do not hold up a whole share
+    std::vector<Result> results(options->inputs.size());
+    std::atomic<size_t> next = 0;
+    auto work = [&] {
+        for (size_t i; (i = next.fetch_add(1)) < results.size();) {
+            const ParseCache *fileCache = cache ? &*cache : nullptr;
+            results[i] = compileFile(options->inputs[i], *options, fileCache, *target, targetTriple);
+        }
+    };
+
+    unsigned jobs = options->jobs ? options->jobs : std::max(1u, std::thread::hardware_concurrency());
+    jobs = static_cast<unsigned>(std::min<size_t>(jobs, results.size()));
+    {
+        std::vector<std::jthread> workers;
+        for (unsigned i = 1; i < jobs; i++) workers.emplace_back(work);
+        work();
+    }
+
+    int status = EX_OK;
+    for (const Result &result : results) {
+        std::cout << result.out;
+        std::cerr << result.err;
+        if (status == EX_OK) status = result.status;
+    }
+    std::cout << std::flush;
 
-    return compile(statements, argv[1]);
+    return status;
 }
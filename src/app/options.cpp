@@ -0,0 +1,136 @@
+#include "options.hpp"
+
+#include <charconv>
+#include <string_view>
+
+namespace {
+std::optional<Emit> parseEmit(std::string_view name) {
+    if (name == "obj") return Emit::Obj;
+    if (name == "exe") return Emit::Exe;
+    if (name == "asm") return Emit::Asm;
+    if (name == "bc") return Emit::Bc;
+    if (name == "ll") return Emit::Ll;
+    return std::nullopt;
+}
+
+// -O alone is -O2, as in clang
+std::optional<llvm::OptimizationLevel> parseOptLevel(std::string_view level) {
+    if (level == "0") return llvm::OptimizationLevel::O0;
+    if (level == "1") return llvm::OptimizationLevel::O1;
+    if (level == "2" || level.empty()) return llvm::OptimizationLevel::O2;
+    if (level == "3") return llvm::OptimizationLevel::O3;
+    if (level == "s") return llvm::OptimizationLevel::Os;
+    if (level == "z") return llvm::OptimizationLevel::Oz;
+    return std::nullopt;
+}
+} // namespace
+
+std::optional<Options> CommandLine::parse(int argc, char **argv, std::ostream &err) {
+    Options options;
+    int first = 1;
+    if (argc > 1 && std::string_view(argv[1]) == "run") {
+        options.run = true;
+        first = 2;
+    }
+
+    for (int i = first; i < argc; i++) {
+        std::string_view arg = argv[i];
+        // The value of an option given as --name=value or --name value
+        auto valueOf = [&](std::string_view name) -> std::optional<std::string_view> {
+            std::string_view value = arg.substr(name.size());
+            if (value.starts_with('=')) return value.substr(1);
+            if (value.empty() && i + 1 < argc) return argv[++i];
+            return std::nullopt;
+        };
+
+        if (arg.starts_with("--cache-dir")) {
+            std::optional<std::string_view> value = valueOf("--cache-dir");
+            if (!value) return std::nullopt;
+            options.cacheDir = *value;
+            continue;
+        }
+        if (arg.starts_with("--cpu")) {
+            std::optional<std::string_view> value = valueOf("--cpu");
+            if (!value || value->empty()) return std::nullopt;
+            options.cpu = *value;
+            continue;
+        }
+        if (arg.starts_with("--features")) {
+            std::optional<std::string_view> value = valueOf("--features");
+            if (!value) return std::nullopt;
+            options.features = *value;
+            continue;
+        }
+        if (arg == "--dump-ast" || arg.starts_with("--dump-ast=")) {
+            options.dumpAst = arg == "--dump-ast" ? AstFormat::Text : AstDump::parseFormat(arg.substr(11));
+            if (!options.dumpAst) {
+                err << "Unknown AST format '" << arg.substr(11) << "'\n";
+                return std::nullopt;
+            }
+            continue;
+        }
+        if (arg == "--emit-ir") {
+            options.emitIr = true;
+            continue;
+        }
+        if (arg.starts_with("--emit")) {
+            std::optional<std::string_view> value = valueOf("--emit");
+            if (!value) return std::nullopt;
+            std::optional<Emit> emit = parseEmit(*value);
+            if (!emit) {
+                err << "Unknown output kind '" << *value << "'\n";
+                return std::nullopt;
+            }
+            options.emit = *emit;
+            continue;
+        }
+        // -o FILE or -oFILE, as in C compilers. -o=FILE is an error rather than a file named =FILE.
+        if (arg.starts_with("-o")) {
+            std::string_view value = arg.substr(2);
+            if (value.empty() && ++i < argc) value = argv[i];
+            if (value.empty() || arg.starts_with("-o=")) {
+                err << "Expected -o FILE or -oFILE\n";
+                return std::nullopt;
+            }
+            options.output = value;
+            continue;
+        }
+        if (arg.starts_with("-O")) {
+            std::optional<llvm::OptimizationLevel> level = parseOptLevel(arg.substr(2));
+            if (!level) {
+                err << "Unknown optimization level '" << arg << "'\n";
+                return std::nullopt;
+            }
+            options.optLevel = *level;
+            continue;
+        }
+        if (!arg.starts_with('-')) {
+            options.inputs.emplace_back(arg);
+            continue;
+        }
+        if (!arg.starts_with("-j")) {
+            err << "Unknown option '" << arg << "'\n";
+            return std::nullopt;
+        }
+
+        std::string_view value = arg.substr(2);
+        if (value.empty() && ++i < argc) value = argv[i];
+        auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), options.jobs);
+        if (ec != std::errc() || end != value.data() + value.size() || options.jobs == 0) {
+            err << "Invalid job count '" << value << "'\n";
+            return std::nullopt;
+        }
+    }
+
+    if (options.inputs.empty()) return std::nullopt;
+    if ((options.run || options.output) && options.inputs.size() > 1) return std::nullopt;
+    return options;
+}
+
+void CommandLine::usage(std::ostream &err, const char *program) {
+    err << "Usage: " << program << " [run]"
+        << " [-j N] [-O0|-O1|-O2|-O3|-Os|-Oz] [--cpu=native|NAME] [--features=+F,-F...]"
+           " [--emit=obj|exe|asm|bc|ll] [-o FILE] [--cache-dir=DIR] [--dump-ast[=text|json|sexpr]]"
+           " [--emit-ir] <file.mrbl>...\n"
+        << "       " << program << "   (interactive session)\n";
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "printer.hpp"
+
+#include "llvm/Passes/OptimizationLevel.h"
+
+// What a compiled file is written as
+enum class Emit : uint8_t { Obj, Exe, Asm, Bc, Ll };
+
+struct Options {
+    bool run = false; // marbl run: JIT compile the one input and call its main instead of writing an object
+    unsigned jobs = 0; // 0: one per hardware thread
+    std::optional<std::string> cacheDir;
+    std::optional<AstFormat> dumpAst;
+    bool emitIr = false;
+    Emit emit = Emit::Obj;
+    std::optional<std::string> output; // -o, for a single input; by default build/<stem> and an extension
+    llvm::OptimizationLevel optLevel = llvm::OptimizationLevel::O0;
+    std::string cpu = "generic"; // "native" is replaced by the host's CPU and features before compiling
+    std::string features;        // LLVM's comma-separated list, e.g. "+avx2,-fma"
+    std::vector<std::string> inputs;
+};
+
+namespace CommandLine {
+// nullopt when the arguments are not a valid command line; what was wrong with them, when more than the
+// usage message can say, is written to `err`
+std::optional<Options> parse(int argc, char **argv, std::ostream &err);
+void usage(std::ostream &err, const char *program);
+} // namespace CommandLine
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <utility>
+
+// Bump allocator for AST nodes and their child lists. Nodes are never destroyed one by one: everything they
+// own is either trivially destructible or allocated from the same arena, so the whole tree is released at
+// once when the arena goes away.
+class AstArena {
+  public:
+    explicit AstArena(size_t initialSize = 64 * 1024) : resource(initialSize) {}
+    AstArena(const AstArena &) = delete;
+    AstArena &operator=(const AstArena &) = delete;
+
+    template <typename T, typename... Args> T *make(Args &&...args) {
+        void *memory = resource.allocate(sizeof(T), alignof(T));
+        return new (memory) T(std::forward<Args>(args)...);
+    }
+
+    std::pmr::memory_resource *getResource() { return &resource; }
+
+  private:
+    std::pmr::monotonic_buffer_resource resource;
+};
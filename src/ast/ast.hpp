@@ -1,14 +1,20 @@
 #pragma once
 
-#include <memory>
+#include <cstdint>
+#include <memory_resource>
 #include <string>
+#include <utility>
+#include <vector>
 
-#include "llvm-18/llvm/IR/IRBuilder.h"
 #include "tokens.hpp"
+#include "types.hpp"
 
 // ======= Utility Types =======
-using UniqueExpr = std::unique_ptr<class Expr>;
-using UniqueStmt = std::unique_ptr<class Stmt>;
+// Nodes live in the AstArena of their Program (see program.hpp), so links between them are plain pointers
+// and child lists allocate from the same arena.
+using ExprPtr = class Expr *;
+using StmtPtr = class Stmt *;
+template <typename T> using AstList = std::pmr::vector<T>;
 
 // ======= AST Node Field Macros =======
 #define FIELD_MEMBER(type, name) type name;
@@ -27,6 +33,7 @@ class Variable;
 class Assign;
 class Logical;
 class Call;
+class TypeAnnotation;
 
 class Expression;
 class Print;
@@ -36,24 +43,28 @@ class If;
 class While;
 class Function;
 class Class;
+class Return;
 
-#define BINARY_FIELDS(X, Y) X(UniqueExpr, left) X(Token, op) Y(UniqueExpr, right)
-#define GROUPING_FIELDS(X, Y) Y(UniqueExpr, expression)
-#define LITERAL_FIELDS(X, Y) Y(Object, value)
-#define UNARY_FIELDS(X, Y) X(Token, op) Y(UniqueExpr, right)
+#define BINARY_FIELDS(X, Y) X(ExprPtr, left) X(Token, op) Y(ExprPtr, right)
+#define GROUPING_FIELDS(X, Y) Y(ExprPtr, expression)
+#define LITERAL_FIELDS(X, Y) X(Token, token) Y(Object, value)
+#define UNARY_FIELDS(X, Y) X(Token, op) Y(ExprPtr, right)
 #define VARIABLE_FIELDS(X, Y) Y(Token, name)
-#define ASSIGN_FIELDS(X, Y) X(Token, name) Y(UniqueExpr, value)
-#define LOGICAL_FIELDS(X, Y) X(UniqueExpr, left) X(Token, op) Y(UniqueExpr, right)
-#define CALL_FIELDS(X, Y) X(UniqueExpr, callee) X(Token, paren) Y(std::vector<UniqueExpr>, arguments)
-
-#define EXPRESSION_FIELDS(X, Y) Y(UniqueExpr, expression)
-#define PRINT_FIELDS(X, Y) Y(UniqueExpr, expression)
-#define LET_FIELDS(X, Y) X(Token, name) Y(UniqueExpr, initializer)
-#define BLOCK_FIELDS(X, Y) Y(std::vector<UniqueStmt>, statements)
-#define IF_FIELDS(X, Y) X(UniqueExpr, condition) X(UniqueStmt, thenBranch) Y(UniqueStmt, elseBranch)
-#define WHILE_FIELDS(X, Y) X(UniqueExpr, condition) Y(UniqueStmt, body)
-#define FUNCTION_FIELDS(X, Y) X(Token, name) X(std::vector<Token>, params) Y(std::vector<UniqueStmt>, body)
-#define CLASS_FIELDS(X, Y) X(Token, name) X(std::vector<Let>, fields) Y(std::vector<Function>, methods)
+#define ASSIGN_FIELDS(X, Y) X(Token, name) Y(ExprPtr, value)
+#define LOGICAL_FIELDS(X, Y) X(ExprPtr, left) X(Token, op) Y(ExprPtr, right)
+#define CALL_FIELDS(X, Y) X(ExprPtr, callee) X(Token, paren) Y(AstList<ExprPtr>, arguments)
+#define TYPE_ANNOTATION_FIELDS(X, Y) Y(Token, name)
+
+#define EXPRESSION_FIELDS(X, Y) Y(ExprPtr, expression)
+#define PRINT_FIELDS(X, Y) Y(ExprPtr, expression)
+#define LET_FIELDS(X, Y) X(Token, name) X(ExprPtr, annotation) Y(ExprPtr, initializer)
+#define BLOCK_FIELDS(X, Y) Y(AstList<StmtPtr>, statements)
+#define IF_FIELDS(X, Y) X(ExprPtr, condition) X(StmtPtr, thenBranch) Y(StmtPtr, elseBranch)
+#define WHILE_FIELDS(X, Y) X(ExprPtr, condition) Y(StmtPtr, body)
+#define FUNCTION_FIELDS(X, Y)                                                                                \
+    X(Token, name) X(AstList<Let>, params) X(ExprPtr, returnAnnotation) Y(AstList<StmtPtr>, body)
+#define CLASS_FIELDS(X, Y) X(Token, name) X(AstList<Let>, fields) Y(AstList<Function>, methods)
+#define RETURN_FIELDS(X, Y) X(Token, keyword) Y(ExprPtr, value)
 
 #define EXPR_AST_NODES(X)                                                                                    \
     X(Binary, BINARY_FIELDS, Expr)                                                                           \
@@ -63,7 +74,8 @@ class Class;
     X(Variable, VARIABLE_FIELDS, Expr)                                                                       \
     X(Assign, ASSIGN_FIELDS, Expr)                                                                           \
     X(Logical, LOGICAL_FIELDS, Expr)                                                                         \
-    X(Call, CALL_FIELDS, Expr)
+    X(Call, CALL_FIELDS, Expr)                                                                               \
+    X(TypeAnnotation, TYPE_ANNOTATION_FIELDS, Expr)
 
 #define STMT_AST_NODES(X)                                                                                    \
     X(Expression, EXPRESSION_FIELDS, Stmt)                                                                   \
@@ -73,58 +85,84 @@ class Class;
     X(If, IF_FIELDS, Stmt)                                                                                   \
     X(While, WHILE_FIELDS, Stmt)                                                                             \
     X(Function, FUNCTION_FIELDS, Stmt)                                                                       \
-    X(Class, CLASS_FIELDS, Stmt)
-
-// ======= Visitor Template =======
-template <typename T> class ExprVisitor {
-  public:
-#define VISIT_METHOD(name, FIELDS, basename) virtual T visit##name##Expr(name &expr) = 0;
-    EXPR_AST_NODES(VISIT_METHOD)
-#undef VISIT_METHOD
-};
-
-template <typename T> class StmtVisitor {
-  public:
-#define VISIT_METHOD(name, FIELDS, basename) virtual T visit##name##Stmt(name &stmt) = 0;
-    STMT_AST_NODES(VISIT_METHOD)
-#undef VISIT_METHOD
+    X(Class, CLASS_FIELDS, Stmt)                                                                             \
+    X(Return, RETURN_FIELDS, Stmt)
+
+// ======= Node Kinds =======
+enum class NodeKind : uint8_t {
+#define NODE_KIND(name, FIELDS, basename) name,
+    EXPR_AST_NODES(NODE_KIND) STMT_AST_NODES(NODE_KIND)
+#undef NODE_KIND
 };
 
 // ======= Expr & Smt Base Class =======
+// Nodes carry their kind instead of a vtable. accept() switches on it and calls the matching
+// visit<Name>Expr/visit<Name>Stmt of whatever visitor it is given, so a visitor is any class with those
+// methods and may return any type.
 class Expr {
   public:
-    virtual ~Expr() = default;
-    virtual void accept(ExprVisitor<void> &visitor) = 0;
-    virtual Object accept(ExprVisitor<Object> &visitor) = 0;
-    virtual llvm::Value *accept(ExprVisitor<llvm::Value *> &visitor) = 0;
+    const NodeKind kind;
+    Type type = Type::Unknown; // Set by the type checker; a TypeAnnotation holds the type it names
+    // Set by the resolver on a Variable or an Assign: the variable is in the scope `depth` scopes out from
+    // the use (0 for the innermost one), at index `slot` of that scope. Fits in the padding after `type`.
+    uint16_t depth = 0;
+    uint32_t slot = 0;
+
+    template <typename Visitor> decltype(auto) accept(Visitor &visitor);
+
+    // The node as a T, or nullptr when it is of another kind
+    template <typename T> T *as() { return kind == T::KIND ? static_cast<T *>(this) : nullptr; }
+
+  protected:
+    explicit Expr(NodeKind kind) : kind(kind) {}
 };
 
 class Stmt {
   public:
-    virtual ~Stmt() = default;
-    virtual void accept(StmtVisitor<void> &visitor) = 0;
-    virtual Object accept(StmtVisitor<Object> &visitor) = 0;
-    virtual llvm::Value *accept(StmtVisitor<llvm::Value *> &visitor) = 0;
+    const NodeKind kind;
+    Type declaredType = Type::Unknown; // Set by the type checker: a Let's variable, a Function's return value
+    bool reassigned = false;           // Set by the resolver on a Let that some Assign writes to
+    uint32_t slot = 0;                 // Set by the resolver on a Let or a Function: its index in its scope
+
+    template <typename Visitor> decltype(auto) accept(Visitor &visitor);
+
+    template <typename T> T *as() { return kind == T::KIND ? static_cast<T *>(this) : nullptr; }
+
+  protected:
+    explicit Stmt(NodeKind kind) : kind(kind) {}
 };
 
 // ======= AST Subclass Macro =======
 #define DEFINE_AST_SUBCLASS(name, FIELDS, basename)                                                          \
     class name : public basename {                                                                           \
       public:                                                                                                \
+        static constexpr NodeKind KIND = NodeKind::name;                                                     \
         FIELDS(FIELD_MEMBER, FIELD_MEMBER)                                                                   \
-        name(FIELDS(FIELD_PARAMS, FIELD_PARAMS_END)) : FIELDS(FIELD_INIT, FIELD_INIT_END) {                  \
-        }                                                                                                    \
-        void accept(basename##Visitor<void> &visitor) override {                                             \
-            visitor.visit##name##basename(*this);                                                            \
-        }                                                                                                    \
-        Object accept(basename##Visitor<Object> &visitor) override {                                         \
-            return visitor.visit##name##basename(*this);                                                     \
-        }                                                                                                    \
-        llvm::Value *accept(basename##Visitor<llvm::Value *> &visitor) override {                            \
-            return visitor.visit##name##basename(*this);                                                     \
-        }                                                                                                    \
+        name(FIELDS(FIELD_PARAMS, FIELD_PARAMS_END))                                                         \
+            : basename(KIND), FIELDS(FIELD_INIT, FIELD_INIT_END) {}                                          \
     };
 
 // ======= Generate AST Nodes =======
 EXPR_AST_NODES(DEFINE_AST_SUBCLASS)
 STMT_AST_NODES(DEFINE_AST_SUBCLASS)
+
+// ======= Dispatch =======
+template <typename Visitor> decltype(auto) Expr::accept(Visitor &visitor) {
+    switch (kind) {
+#define DISPATCH(name, FIELDS, basename)                                                                     \
+    case NodeKind::name: return visitor.visit##name##Expr(static_cast<name &>(*this));
+        EXPR_AST_NODES(DISPATCH)
+#undef DISPATCH
+    default: std::unreachable();
+    }
+}
+
+template <typename Visitor> decltype(auto) Stmt::accept(Visitor &visitor) {
+    switch (kind) {
+#define DISPATCH(name, FIELDS, basename)                                                                     \
+    case NodeKind::name: return visitor.visit##name##Stmt(static_cast<name &>(*this));
+        STMT_AST_NODES(DISPATCH)
+#undef DISPATCH
+    default: std::unreachable();
+    }
+}
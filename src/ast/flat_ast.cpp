@@ -0,0 +1,334 @@
+#include "flat_ast.hpp"
+
+#include <array>
+
+namespace {
+// Lowers the pointer AST into a FlatAst, one node per visit. Children are converted before their parent is
+// pushed, which is what gives the arrays their post-order layout.
+class FlatBuilder {
+  public:
+    explicit FlatBuilder(FlatAst &flat) : flat(flat) {}
+
+    NodeRef lower(Stmt &stmt) {
+        stmt.accept(*this);
+        return result;
+    }
+
+  private:
+    friend class ::Expr;
+    friend class ::Stmt;
+
+    FlatAst &flat;
+    NodeRef result;
+
+    NodeRef convert(ExprPtr expr) {
+        if (!expr) return NodeRef();
+        expr->accept(*this);
+        return result;
+    }
+    NodeRef convert(StmtPtr stmt) {
+        if (!stmt) return NodeRef();
+        stmt->accept(*this);
+        return result;
+    }
+    NodeRef convert(Let &let) { return convert(static_cast<StmtPtr>(&let)); }
+    NodeRef convert(Function &function) { return convert(static_cast<StmtPtr>(&function)); }
+    TokenIndex convert(const Token &token) { return token.index; }
+    Object convert(const Object &value) { return value; }
+
+    uint32_t listItem(NodeRef ref) { return ref.getRaw(); }
+    uint32_t listItem(TokenIndex index) { return index; }
+
+    // Nested lists are written while converting the elements, so collect first and append afterwards
+    template <typename T> ListRef convert(AstList<T> &list) {
+        std::vector<uint32_t> items;
+        items.reserve(list.size());
+        for (auto &item : list) items.push_back(listItem(convert(item)));
+
+        ListRef ref{static_cast<uint32_t>(flat.lists.size()), static_cast<uint32_t>(items.size())};
+        flat.lists.insert(flat.lists.end(), items.begin(), items.end());
+        return ref;
+    }
+
+#define FLAT_CONVERT(type, name) convert(node.name),
+#define FLAT_CONVERT_END(type, name) convert(node.name)
+#define VISIT_FLAT(name, FIELDS, basename)                                                                   \
+    void visit##name##basename(name &node) {                                                        \
+        result = flat.push(Flat::name{FIELDS(FLAT_CONVERT, FLAT_CONVERT_END)});                              \
+    }
+    EXPR_AST_NODES(VISIT_FLAT)
+    STMT_AST_NODES(VISIT_FLAT)
+#undef VISIT_FLAT
+#undef FLAT_CONVERT_END
+#undef FLAT_CONVERT
+};
+
+// Turns a FlatAst back into arena nodes. A field is converted by the type the pointer AST declares for it,
+// which the FIELDS macros pass along as a std::type_identity tag.
+#define UNFLATTEN_FIELD(type, name) convert(std::type_identity<type>{}, node.name),
+#define UNFLATTEN_FIELD_END(type, name) convert(std::type_identity<type>{}, node.name)
+class Unflattener {
+  public:
+    Unflattener(const FlatAst &flat, AstArena &arena) : flat(flat), arena(arena) {}
+
+    StmtPtr stmt(NodeRef ref) {
+        if (ref.isNull()) return nullptr;
+        switch (ref.kind()) {
+#define UNFLATTEN_STMT(name, FIELDS, basename)                                                               \
+    case NodeKind::name: {                                                                                   \
+        const Flat::name &node = flat.get<Flat::name>(ref);                                                  \
+        return arena.make<name>(FIELDS(UNFLATTEN_FIELD, UNFLATTEN_FIELD_END));                               \
+    }
+            STMT_AST_NODES(UNFLATTEN_STMT)
+#undef UNFLATTEN_STMT
+        default: std::unreachable();
+        }
+    }
+
+    ExprPtr expr(NodeRef ref) {
+        if (ref.isNull()) return nullptr;
+        switch (ref.kind()) {
+#define UNFLATTEN_EXPR(name, FIELDS, basename)                                                               \
+    case NodeKind::name: {                                                                                   \
+        const Flat::name &node = flat.get<Flat::name>(ref);                                                  \
+        return arena.make<name>(FIELDS(UNFLATTEN_FIELD, UNFLATTEN_FIELD_END));                               \
+    }
+            EXPR_AST_NODES(UNFLATTEN_EXPR)
+#undef UNFLATTEN_EXPR
+        default: std::unreachable();
+        }
+    }
+
+  private:
+    const FlatAst &flat;
+    AstArena &arena;
+
+    ExprPtr convert(std::type_identity<ExprPtr>, NodeRef ref) { return expr(ref); }
+    StmtPtr convert(std::type_identity<StmtPtr>, NodeRef ref) { return stmt(ref); }
+    // Class members are stored by value
+    Let convert(std::type_identity<Let>, NodeRef ref) {
+        const Flat::Let &node = flat.get<Flat::Let>(ref);
+        return Let{LET_FIELDS(UNFLATTEN_FIELD, UNFLATTEN_FIELD_END)};
+    }
+    Function convert(std::type_identity<Function>, NodeRef ref) {
+        const Flat::Function &node = flat.get<Flat::Function>(ref);
+        return Function{FUNCTION_FIELDS(UNFLATTEN_FIELD, UNFLATTEN_FIELD_END)};
+    }
+    Token convert(std::type_identity<Token>, TokenIndex index) { return flat.token(index); }
+    Object convert(std::type_identity<Object>, const Object &value) { return value; }
+
+    template <typename T> T listItem(uint32_t item) {
+        if constexpr (std::is_same_v<T, Token>) {
+            return flat.token(item);
+        } else {
+            return convert(std::type_identity<T>{}, NodeRef::fromRaw(item));
+        }
+    }
+
+    template <typename T> AstList<T> convert(std::type_identity<AstList<T>>, ListRef ref) {
+        AstList<T> list(arena.getResource());
+        list.reserve(ref.count);
+        for (uint32_t item : flat.list(ref)) list.push_back(listItem<T>(item));
+        return list;
+    }
+};
+#undef UNFLATTEN_FIELD_END
+#undef UNFLATTEN_FIELD
+
+// Expression kinds come first in NodeKind
+#define COUNT_NODE(name, FIELDS, basename) +1
+constexpr uint8_t EXPR_KINDS = 0 EXPR_AST_NODES(COUNT_NODE);
+constexpr uint8_t NODE_KINDS = EXPR_KINDS STMT_AST_NODES(COUNT_NODE);
+#undef COUNT_NODE
+
+bool isExpr(NodeRef ref) { return static_cast<uint8_t>(ref.kind()) < EXPR_KINDS; }
+bool isStmt(NodeRef ref) {
+    auto kind = static_cast<uint8_t>(ref.kind());
+    return kind >= EXPR_KINDS && kind < NODE_KINDS;
+}
+
+// Checks a FlatAst read from disk before Unflattener follows it, walking it the same way: every reference
+// names an existing node of a kind its field can hold, every token and list is in range, and no node is
+// reached twice, which also rules out cycles.
+#define VALIDATE_FIELD(type, name) &&check(std::type_identity<type>{}, node.name)
+class Validator {
+  public:
+    explicit Validator(const FlatAst &flat) : flat(flat) {
+#define SIZE_REACHED(name, FIELDS, basename)                                                                 \
+    reached[static_cast<size_t>(NodeKind::name)].resize(flat.nodes<Flat::name>().size());
+        EXPR_AST_NODES(SIZE_REACHED)
+        STMT_AST_NODES(SIZE_REACHED)
+#undef SIZE_REACHED
+    }
+
+    bool root(NodeRef ref) { return !ref.isNull() && isStmt(ref) && node(ref); }
+
+  private:
+    const FlatAst &flat;
+    std::array<std::vector<bool>, NODE_KINDS> reached;
+
+    bool node(NodeRef ref) {
+        std::vector<bool> &seen = reached[static_cast<size_t>(ref.kind())];
+        if (ref.index() >= seen.size() || seen[ref.index()]) return false;
+        seen[ref.index()] = true;
+
+        switch (ref.kind()) {
+#define VALIDATE_NODE(name, FIELDS, basename)                                                                \
+    case NodeKind::name: {                                                                                   \
+        const Flat::name &node = flat.get<Flat::name>(ref);                                                  \
+        return true FIELDS(VALIDATE_FIELD, VALIDATE_FIELD);                                                  \
+    }
+            EXPR_AST_NODES(VALIDATE_NODE)
+            STMT_AST_NODES(VALIDATE_NODE)
+#undef VALIDATE_NODE
+        }
+        return false;
+    }
+
+    bool check(std::type_identity<ExprPtr>, NodeRef ref) {
+        return ref.isNull() || (isExpr(ref) && node(ref));
+    }
+    bool check(std::type_identity<StmtPtr>, NodeRef ref) {
+        return ref.isNull() || (isStmt(ref) && node(ref));
+    }
+    bool check(std::type_identity<Let>, NodeRef ref) {
+        return !ref.isNull() && ref.kind() == NodeKind::Let && node(ref);
+    }
+    bool check(std::type_identity<Function>, NodeRef ref) {
+        return !ref.isNull() && ref.kind() == NodeKind::Function && node(ref);
+    }
+    bool check(std::type_identity<Token>, TokenIndex index) { return index < flat.tokens->size(); }
+    bool check(std::type_identity<Object>, const Object &) { return true; }
+
+    // The parser never leaves a null node in a list
+    template <typename T> bool check(std::type_identity<AstList<T>>, ListRef ref) {
+        if (ref.begin > flat.lists.size() || ref.count > flat.lists.size() - ref.begin) return false;
+        for (uint32_t item : flat.list(ref)) {
+            if constexpr (std::is_same_v<T, Token>) {
+                if (!check(std::type_identity<Token>{}, item)) return false;
+            } else {
+                NodeRef node = NodeRef::fromRaw(item);
+                if (node.isNull() || !check(std::type_identity<T>{}, node)) return false;
+            }
+        }
+        return true;
+    }
+};
+#undef VALIDATE_FIELD
+
+// Per-field encoding of the flat nodes. Everything is a varint; a reference is its kind in one byte
+// (NULL_KIND for none) and then its index.
+constexpr uint8_t NULL_KIND = 0xff;
+
+void writeField(BinaryWriter &out, NodeRef ref) {
+    out.value<uint8_t>(ref.isNull() ? NULL_KIND : static_cast<uint8_t>(ref.kind()));
+    if (!ref.isNull()) out.varint(ref.index());
+}
+void writeField(BinaryWriter &out, TokenIndex index) { out.varint(index); }
+void writeField(BinaryWriter &out, ListRef ref) {
+    out.varint(ref.begin);
+    out.varint(ref.count);
+}
+void writeField(BinaryWriter &out, const Object &value) { out.object(value); }
+
+void readField(BinaryReader &in, NodeRef &ref) {
+    uint8_t kind = in.value<uint8_t>();
+    if (kind == NULL_KIND) {
+        ref = NodeRef();
+        return;
+    }
+    uint64_t index = in.varint();
+    if (kind >= NODE_KINDS || index > NodeRef::INDEX_MASK) {
+        in.fail();
+        return;
+    }
+    ref = NodeRef(static_cast<NodeKind>(kind), static_cast<uint32_t>(index));
+}
+void readField(BinaryReader &in, TokenIndex &index) { index = static_cast<TokenIndex>(in.varint()); }
+void readField(BinaryReader &in, ListRef &ref) {
+    ref.begin = static_cast<uint32_t>(in.varint());
+    ref.count = static_cast<uint32_t>(in.varint());
+}
+void readField(BinaryReader &in, Object &value) { value = in.object(); }
+} // namespace
+
+FlatAst FlatAst::build(Program &program) {
+    FlatAst flat;
+    flat.tokens = program.tokens;
+
+    FlatBuilder builder{flat};
+    flat.roots.reserve(program.statements.size());
+    for (StmtPtr stmt : program.statements) {
+        if (stmt) flat.roots.push_back(builder.lower(*stmt));
+    }
+
+    return flat;
+}
+
+size_t FlatAst::nodeCount() const {
+    return std::apply([](const auto &...array) { return (array.size() + ...); }, arrays.arrays);
+}
+
+size_t FlatAst::memoryUsage() const {
+    size_t bytes = roots.capacity() * sizeof(NodeRef) + lists.capacity() * sizeof(uint32_t);
+    std::apply([&](const auto &...array) { ((bytes += array.capacity() * sizeof(array[0])), ...); },
+               arrays.arrays);
+    return bytes;
+}
+
+Program FlatAst::unflatten() const {
+    Program program;
+    program.tokens = tokens;
+
+    Unflattener unflattener{*this, *program.arena};
+    program.statements.reserve(roots.size());
+    for (NodeRef root : roots) program.statements.push_back(unflattener.stmt(root));
+
+    return program;
+}
+
+void FlatAst::write(BinaryWriter &out) const {
+    out.varint(roots.size());
+    for (NodeRef root : roots) writeField(out, root);
+    out.varint(lists.size());
+    for (uint32_t item : lists) out.varint(item);
+
+#define WRITE_FIELD(type, name) writeField(out, node.name);
+#define WRITE_NODES(name, FIELDS, basename)                                                                  \
+    out.varint(nodes<Flat::name>().size());                                                                  \
+    for (const Flat::name &node : nodes<Flat::name>()) { FIELDS(WRITE_FIELD, WRITE_FIELD) }
+    EXPR_AST_NODES(WRITE_NODES)
+    STMT_AST_NODES(WRITE_NODES)
+#undef WRITE_NODES
+#undef WRITE_FIELD
+}
+
+std::optional<FlatAst> FlatAst::read(BinaryReader &in, std::shared_ptr<const TokenStream> tokens) {
+    FlatAst flat;
+    flat.tokens = std::move(tokens);
+
+    uint64_t count = in.varint();
+    for (uint64_t i = 0; i < count && in.ok(); i++) readField(in, flat.roots.emplace_back());
+    count = in.varint();
+    for (uint64_t i = 0; i < count && in.ok(); i++) flat.lists.push_back(static_cast<uint32_t>(in.varint()));
+
+#define READ_FIELD(type, name) readField(in, node.name);
+#define READ_NODES(name, FIELDS, basename)                                                                   \
+    count = in.varint();                                                                                     \
+    for (uint64_t i = 0; i < count && in.ok(); i++) {                                                        \
+        Flat::name node{};                                                                                   \
+        FIELDS(READ_FIELD, READ_FIELD)                                                                       \
+        flat.push(std::move(node));                                                                          \
+    }
+    EXPR_AST_NODES(READ_NODES)
+    STMT_AST_NODES(READ_NODES)
+#undef READ_NODES
+#undef READ_FIELD
+
+    if (!in.ok()) return std::nullopt;
+    Validator validator{flat};
+    for (NodeRef root : flat.roots) {
+        if (!validator.root(root)) return std::nullopt;
+    }
+    return flat;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <vector>
+
+#include "ast.hpp"
+#include "binary_io.hpp"
+#include "program.hpp"
+#include "token_stream.hpp"
+
+// Pointer-free snapshot of a Program, which is what the parse cache writes to disk: every node kind lives in
+// its own contiguous array, children are 32-bit references into those arrays and tokens are indices into the
+// program's TokenStream, so nothing in it needs relocating. write() and read() still go node by node and
+// field by field, with every integer as a varint.
+//
+// It is a serialization format, not a second IR. It is lowered from a parsed Program and unflattened back
+// into one, and every pass works on the pointer AST, so building it adds to peak memory instead of saving it.
+
+// ======= References =======
+// The node kind in the top 5 bits, the index in that kind's array below
+class NodeRef {
+  public:
+    static constexpr uint32_t INDEX_BITS = 27;
+    static constexpr uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+
+    NodeRef() : raw(UINT32_MAX) {}
+    NodeRef(NodeKind kind, uint32_t index) : raw(static_cast<uint32_t>(kind) << INDEX_BITS | index) {}
+    static NodeRef fromRaw(uint32_t raw) {
+        NodeRef ref;
+        ref.raw = raw;
+        return ref;
+    }
+
+    bool isNull() const { return raw == UINT32_MAX; }
+    NodeKind kind() const { return static_cast<NodeKind>(raw >> INDEX_BITS); }
+    uint32_t index() const { return raw & INDEX_MASK; }
+    uint32_t getRaw() const { return raw; }
+
+  private:
+    uint32_t raw;
+};
+
+using TokenIndex = uint32_t;
+
+// A run of FlatAst::lists: node references for node lists, token indices for token lists
+struct ListRef {
+    uint32_t begin = 0;
+    uint32_t count = 0;
+};
+
+// ======= Flat Nodes =======
+// Same fields as the pointer AST, with each field type mapped by FlatField
+template <typename T> struct FlatField {
+    using type = T;
+};
+template <> struct FlatField<ExprPtr> {
+    using type = NodeRef;
+};
+template <> struct FlatField<StmtPtr> {
+    using type = NodeRef;
+};
+template <> struct FlatField<Token> {
+    using type = TokenIndex;
+};
+template <typename T> struct FlatField<AstList<T>> {
+    using type = ListRef;
+};
+
+namespace Flat {
+#define FLAT_MEMBER(fieldType, name) FlatField<fieldType>::type name;
+#define DEFINE_FLAT_NODE(name, FIELDS, basename)                                                             \
+    struct name {                                                                                            \
+        static constexpr NodeKind kind = NodeKind::name;                                                     \
+        FIELDS(FLAT_MEMBER, FLAT_MEMBER)                                                                     \
+    };
+EXPR_AST_NODES(DEFINE_FLAT_NODE)
+STMT_AST_NODES(DEFINE_FLAT_NODE)
+#undef DEFINE_FLAT_NODE
+#undef FLAT_MEMBER
+} // namespace Flat
+
+// ======= Flat AST =======
+class FlatAst {
+  public:
+    std::shared_ptr<const TokenStream> tokens;
+    std::vector<NodeRef> roots; // Top-level statements
+    std::vector<uint32_t> lists;
+
+    static FlatAst build(Program &program);
+    // Rebuilds the pointer AST, with the tokens read back from `tokens`
+    Program unflatten() const;
+
+    // The nodes, roots and lists; the token stream is written separately. read() returns nullopt unless
+    // every reference, token index and list in the blob is in range and the roots reach a tree, so what
+    // it returns can be unflattened.
+    void write(BinaryWriter &out) const;
+    static std::optional<FlatAst> read(BinaryReader &in, std::shared_ptr<const TokenStream> tokens);
+
+    template <typename T> std::vector<T> &nodes() { return std::get<std::vector<T>>(arrays.arrays); }
+    template <typename T> const std::vector<T> &nodes() const {
+        return std::get<std::vector<T>>(arrays.arrays);
+    }
+
+    template <typename T> T &get(NodeRef ref) { return nodes<T>()[ref.index()]; }
+    template <typename T> const T &get(NodeRef ref) const { return nodes<T>()[ref.index()]; }
+
+    template <typename T> NodeRef push(T node) {
+        std::vector<T> &array = nodes<T>();
+        array.push_back(std::move(node));
+        return NodeRef(T::kind, static_cast<uint32_t>(array.size() - 1));
+    }
+
+    std::span<const uint32_t> list(ListRef ref) const { return {lists.data() + ref.begin, ref.count}; }
+    NodeRef listNode(ListRef ref, uint32_t i) const { return NodeRef::fromRaw(lists[ref.begin + i]); }
+    Token token(TokenIndex index) const { return tokens->at(index); }
+
+    size_t nodeCount() const;
+    size_t memoryUsage() const; // Bytes held by the node arrays and lists, excluding the token stream
+
+  private:
+    template <typename Ignored, typename... Nodes> struct Arrays {
+        std::tuple<std::vector<Nodes>...> arrays;
+    };
+
+#define FLAT_TYPE(name, FIELDS, basename) , Flat::name
+    Arrays<void EXPR_AST_NODES(FLAT_TYPE) STMT_AST_NODES(FLAT_TYPE)> arrays;
+#undef FLAT_TYPE
+};
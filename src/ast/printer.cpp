@@ -1,129 +1,414 @@
 #include "printer.hpp"
 
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+
 void AstPrinter::print(Stmt &stmt) {
-    std::cout << "stmt: ";
+    out << "stmt: ";
     stmt.accept(*this);
-    std::cout << std::endl;
+    out << '\n';
 }
 
 void AstPrinter::visitBinaryExpr(Binary &expr) {
-    std::cout << "( ";
+    out << "( ";
 
     expr.left->accept(*this);
-    std::cout << " ";
+    out << " ";
 
-    std::cout << expr.op.lexeme << " ";
+    out << expr.op.lexeme << " ";
 
     expr.right->accept(*this);
-    std::cout << " )";
+    out << " )";
 }
 
 void AstPrinter::visitLogicalExpr(Logical &expr) {
-    std::cout << "( ";
+    out << "( ";
 
     expr.left->accept(*this);
-    std::cout << " ";
+    out << " ";
 
-    std::cout << expr.op.lexeme << " ";
+    out << expr.op.lexeme << " ";
 
     expr.right->accept(*this);
-    std::cout << " )";
+    out << " )";
 }
 
 void AstPrinter::visitGroupingExpr(Grouping &expr) {
-    std::cout << "( group ";
+    out << "( group ";
     expr.expression->accept(*this);
-    std::cout << " )";
+    out << " )";
 }
 
 void AstPrinter::visitLiteralExpr(Literal &expr) {
-    std::cout << expr.value;
+    out << expr.value;
 }
 
 void AstPrinter::visitUnaryExpr(Unary &expr) {
-    std::cout << "( " << expr.op.lexeme << " ";
+    out << "( " << expr.op.lexeme << " ";
     expr.right->accept(*this);
-    std::cout << " )";
+    out << " )";
 }
 
 void AstPrinter::visitVariableExpr(Variable &expr) {
-    std::cout << expr.name.lexeme;
+    out << expr.name.lexeme;
 }
 
 void AstPrinter::visitAssignExpr(Assign &expr) {
-    std::cout << expr.name.lexeme;
-    std::cout << " = ";
+    out << expr.name.lexeme;
+    out << " = ";
     expr.value->accept(*this);
 }
 
 void AstPrinter::visitExpressionStmt(Expression &stmt) {
     stmt.expression->accept(*this);
-    std::cout << ";";
+    out << ";";
 }
 
 void AstPrinter::visitPrintStmt(Print &stmt) {
-    std::cout << "print(";
+    out << "print(";
     stmt.expression->accept(*this);
-    std::cout << ");";
+    out << ");";
 }
 
 void AstPrinter::visitIfStmt(If &stmt) {
-    std::cout << "if (";
+    out << "if (";
     stmt.condition->accept(*this);
-    std::cout << ") ";
+    out << ") ";
     stmt.thenBranch->accept(*this);
 
     if (stmt.elseBranch) {
-        std::cout << "else ";
+        out << "else ";
         stmt.elseBranch->accept(*this);
     }
 }
 
 void AstPrinter::visitWhileStmt(While &stmt) {
-    std::cout << "while (";
+    out << "while (";
     stmt.condition->accept(*this);
-    std::cout << ") ";
+    out << ") ";
     stmt.body->accept(*this);
 }
 
 void AstPrinter::visitLetStmt(Let &stmt) {
-    std::cout << "let " << stmt.name.literal << " = ";
-    stmt.initializer->accept(*this);
-    std::cout << ";";
+    out << "let " << stmt.name.literal;
+    if (stmt.annotation) {
+        out << ": ";
+        stmt.annotation->accept(*this);
+    }
+    if (stmt.initializer) {
+        out << " = ";
+        stmt.initializer->accept(*this);
+    }
+    out << ";";
 }
 
 void AstPrinter::visitBlockStmt(Block &stmt) {
-    std::cout << "{" << std::endl;
+    out << "{" << '\n';
     for (auto &sub_stmt : stmt.statements) {
         sub_stmt->accept(*this);
-        std::cout << std::endl;
+        out << '\n';
     }
-    std::cout << "}";
+    out << "}";
 }
 
 void AstPrinter::visitCallExpr(Call &expr) {
     expr.callee->accept(*this);
 
-    std::cout << "(";
+    out << "(";
     for (auto &arg : expr.arguments) { arg->accept(*this); }
-    std::cout << ")";
+    out << ")";
 }
 
 void AstPrinter::visitFunctionStmt(Function &stmt) {
-    std::cout << "fn " << stmt.name.lexeme << "(";
-    int i = 0;
+    out << "fn " << stmt.name.lexeme << "(";
+    size_t i = 0;
     for (auto &param : stmt.params) {
-        std::cout << param.lexeme;
-        if (++i < stmt.params.size()) { std::cout << ", "; }
+        out << param.name.lexeme;
+        if (param.annotation) {
+            out << ": ";
+            param.annotation->accept(*this);
+        }
+        if (++i < stmt.params.size()) { out << ", "; }
     }
-    std::cout << ") {";
+    out << ")";
+    if (stmt.returnAnnotation) {
+        out << ": ";
+        stmt.returnAnnotation->accept(*this);
+    }
+    out << " {";
 
     for (auto &fn_stmt : stmt.body) { fn_stmt->accept(*this); }
 
-    std::cout << "}";
+    out << "}";
 }
 
 void AstPrinter::visitClassStmt(Class &stmt) {
-    std::cout << "class " << stmt.name.lexeme << "{";
-    std::cout << "}";
+    out << "class " << stmt.name.lexeme << "{";
+    out << "}";
+}
+
+void AstPrinter::visitTypeAnnotationExpr(TypeAnnotation &expr) {
+    out << expr.name.lexeme;
+}
+
+void AstPrinter::visitReturnStmt(Return &stmt) {
+    out << "return";
+    if (stmt.value) {
+        out << " ";
+        stmt.value->accept(*this);
+    }
+    out << ";";
+}
+
+namespace {
+// Writes `text` as a double-quoted string with JSON escapes, which S-expression readers accept too
+void writeQuoted(std::ostream &out, std::string_view text) {
+    out << '"';
+    for (char c : text) {
+        switch (c) {
+        case '"': out << "\\\""; break;
+        case '\\': out << "\\\\"; break;
+        case '\n': out << "\\n"; break;
+        case '\t': out << "\\t"; break;
+        case '\r': out << "\\r"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char escape[8];
+                std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+                out << escape;
+            } else {
+                out << c;
+            }
+        }
+    }
+    out << '"';
+}
+
+// Whether `text` can be written unquoted in an S-expression
+bool isSymbol(std::string_view text) {
+    return !text.empty() && std::all_of(text.begin(), text.end(), [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || std::string_view("_+-*/<>=!").contains(c);
+    });
+}
+
+// Shortest text that reads back as the same double
+std::string_view formatDouble(double value, char (&buffer)[32]) {
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    return {buffer, static_cast<size_t>(end - buffer)};
+}
+
+// One JSON object per node: {"kind": "Binary", "left": ..., "op": ..., "right": ...}, with the fields in
+// declaration order. Tokens are {"lexeme", "line", "col"} objects and literal values are tagged with their
+// type, e.g. {"int": 1} or {"identifier": "x"}.
+class JsonPrinter {
+  public:
+    explicit JsonPrinter(std::ostream &out) : out(out) {}
+
+    void print(Stmt &stmt) { stmt.accept(*this); }
+
+  private:
+    friend class ::Expr;
+    friend class ::Stmt;
+
+    std::ostream &out;
+
+    void write(ExprPtr expr) {
+        if (expr) {
+            expr->accept(*this);
+        } else {
+            out << "null";
+        }
+    }
+    void write(StmtPtr stmt) {
+        if (stmt) {
+            stmt->accept(*this);
+        } else {
+            out << "null";
+        }
+    }
+    void write(Let &let) { write(static_cast<StmtPtr>(&let)); }
+    void write(Function &function) { write(static_cast<StmtPtr>(&function)); }
+    void write(const Token &token) {
+        out << "{\"lexeme\":";
+        writeQuoted(out, token.lexeme);
+        out << ",\"line\":" << token.line << ",\"col\":" << token.col << '}';
+    }
+    void write(const Object &value) {
+        std::visit(
+            [&](auto &&val) {
+                using T = std::decay_t<decltype(val)>;
+                if constexpr (std::is_same_v<T, int>) {
+                    out << "{\"int\":" << val << '}';
+                } else if constexpr (std::is_same_v<T, double>) {
+                    char buffer[32];
+                    out << "{\"double\":";
+                    if (std::isfinite(val)) {
+                        out << formatDouble(val, buffer);
+                    } else {
+                        out << "null"; // JSON has no infinity
+                    }
+                    out << '}';
+                } else if constexpr (std::is_same_v<T, StringLiteral>) {
+                    out << "{\"string\":";
+                    writeQuoted(out, Symbols::name(val.id));
+                    out << '}';
+                } else if constexpr (std::is_same_v<T, bool>) {
+                    out << "{\"bool\":" << (val ? "true" : "false") << '}';
+                } else {
+                    out << "{\"identifier\":";
+                    writeQuoted(out, Symbols::name(val.id));
+                    out << '}';
+                }
+            },
+            value);
+    }
+    template <typename T> void write(AstList<T> &list) {
+        out << '[';
+        for (size_t i = 0; i < list.size(); i++) {
+            if (i) out << ',';
+            write(list[i]);
+        }
+        out << ']';
+    }
+
+#define JSON_FIELD(type, name)                                                                               \
+    out << ",\"" #name "\":";                                                                                \
+    write(node.name);
+#define VISIT_JSON(name, FIELDS, basename)                                                                   \
+    void visit##name##basename(name &node) {                                                                 \
+        out << "{\"kind\":\"" #name "\"";                                                                    \
+        FIELDS(JSON_FIELD, JSON_FIELD)                                                                       \
+        out << '}';                                                                                          \
+    }
+    EXPR_AST_NODES(VISIT_JSON)
+    STMT_AST_NODES(VISIT_JSON)
+#undef VISIT_JSON
+#undef JSON_FIELD
+};
+
+// One list per node, (Kind field...) with the fields in declaration order. A missing node is nil, a child
+// list is a plain list, a token is its lexeme (quoted unless it is a valid symbol) and a string literal is
+// quoted.
+class SexprPrinter {
+  public:
+    explicit SexprPrinter(std::ostream &out) : out(out) {}
+
+    void print(Stmt &stmt) { stmt.accept(*this); }
+
+  private:
+    friend class ::Expr;
+    friend class ::Stmt;
+
+    std::ostream &out;
+
+    void write(ExprPtr expr) {
+        if (expr) {
+            expr->accept(*this);
+        } else {
+            out << "nil";
+        }
+    }
+    void write(StmtPtr stmt) {
+        if (stmt) {
+            stmt->accept(*this);
+        } else {
+            out << "nil";
+        }
+    }
+    void write(Let &let) { write(static_cast<StmtPtr>(&let)); }
+    void write(Function &function) { write(static_cast<StmtPtr>(&function)); }
+    void write(const Token &token) {
+        if (isSymbol(token.lexeme)) {
+            out << token.lexeme;
+        } else {
+            writeQuoted(out, token.lexeme);
+        }
+    }
+    void write(const Object &value) {
+        std::visit(
+            [&](auto &&val) {
+                using T = std::decay_t<decltype(val)>;
+                if constexpr (std::is_same_v<T, int>) {
+                    out << val;
+                } else if constexpr (std::is_same_v<T, double>) {
+                    // Keep a decimal point so that it does not read back as an integer
+                    char buffer[32];
+                    std::string_view text = formatDouble(val, buffer);
+                    out << text;
+                    if (text.find_first_of(".eian") == std::string_view::npos) out << ".0";
+                } else if constexpr (std::is_same_v<T, StringLiteral>) {
+                    writeQuoted(out, Symbols::name(val.id));
+                } else if constexpr (std::is_same_v<T, bool>) {
+                    out << (val ? "true" : "false");
+                } else {
+                    out << Symbols::name(val.id);
+                }
+            },
+            value);
+    }
+    template <typename T> void write(AstList<T> &list) {
+        out << '(';
+        for (size_t i = 0; i < list.size(); i++) {
+            if (i) out << ' ';
+            write(list[i]);
+        }
+        out << ')';
+    }
+
+#define SEXPR_FIELD(type, name)                                                                              \
+    out << ' ';                                                                                              \
+    write(node.name);
+#define VISIT_SEXPR(name, FIELDS, basename)                                                                  \
+    void visit##name##basename(name &node) {                                                                 \
+        out << "(" #name;                                                                                    \
+        FIELDS(SEXPR_FIELD, SEXPR_FIELD)                                                                     \
+        out << ')';                                                                                          \
+    }
+    EXPR_AST_NODES(VISIT_SEXPR)
+    STMT_AST_NODES(VISIT_SEXPR)
+#undef VISIT_SEXPR
+#undef SEXPR_FIELD
+};
+} // namespace
+
+namespace AstDump {
+std::optional<AstFormat> parseFormat(std::string_view name) {
+    if (name == "text") return AstFormat::Text;
+    if (name == "json") return AstFormat::Json;
+    if (name == "sexpr") return AstFormat::Sexpr;
+    return std::nullopt;
+}
+
+void print(std::ostream &out, Program &program, AstFormat format) {
+    const std::string &file = Sources::get(program.tokens->getFileId()).getName();
+    switch (format) {
+    case AstFormat::Text: {
+        AstPrinter printer{out};
+        for (StmtPtr statement : program.statements) printer.print(*statement);
+        break;
+    }
+    case AstFormat::Json: {
+        JsonPrinter printer{out};
+        out << "{\"file\":";
+        writeQuoted(out, file);
+        out << ",\"statements\":[";
+        for (size_t i = 0; i < program.statements.size(); i++) {
+            if (i) out << ',';
+            printer.print(*program.statements[i]);
+        }
+        out << "]}\n";
+        break;
+    }
+    case AstFormat::Sexpr: {
+        SexprPrinter printer{out};
+        out << "; " << file << '\n';
+        for (StmtPtr statement : program.statements) {
+            printer.print(*statement);
+            out << '\n';
+        }
+        break;
+    }
+    }
 }
+} // namespace AstDump
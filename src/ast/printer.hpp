@@ -1,27 +1,51 @@
 #pragma once
 
+#include <iostream>
+#include <optional>
+#include <string_view>
+
 #include "ast.hpp"
+#include "program.hpp"
 
-class AstPrinter : public ExprVisitor<void>, StmtVisitor<void> {
+class AstPrinter {
   public:
+    explicit AstPrinter(std::ostream &out = std::cout) : out(out) {}
+
     void print(Stmt &expr);
 
   private:
-    void visitBinaryExpr(Binary &expr) override;
-    void visitLogicalExpr(Logical &expr) override;
-    void visitGroupingExpr(Grouping &expr) override;
-    void visitLiteralExpr(Literal &expr) override;
-    void visitUnaryExpr(Unary &expr) override;
-    void visitVariableExpr(Variable &expr) override;
-    void visitAssignExpr(Assign &expr) override;
-    void visitCallExpr(Call &expr) override;
-
-    void visitExpressionStmt(Expression &stmt) override;
-    void visitPrintStmt(Print &stmt) override;
-    void visitLetStmt(Let &stmt) override;
-    void visitBlockStmt(Block &stmt) override;
-    void visitIfStmt(If &stmt) override;
-    void visitWhileStmt(While &stmt) override;
-    void visitFunctionStmt(Function &stmt) override;
-    void visitClassStmt(Class &stmt) override;
+    friend class Expr;
+    friend class Stmt;
+
+    std::ostream &out;
+
+    void visitBinaryExpr(Binary &expr);
+    void visitLogicalExpr(Logical &expr);
+    void visitGroupingExpr(Grouping &expr);
+    void visitLiteralExpr(Literal &expr);
+    void visitUnaryExpr(Unary &expr);
+    void visitVariableExpr(Variable &expr);
+    void visitAssignExpr(Assign &expr);
+    void visitCallExpr(Call &expr);
+    void visitTypeAnnotationExpr(TypeAnnotation &expr);
+
+    void visitExpressionStmt(Expression &stmt);
+    void visitPrintStmt(Print &stmt);
+    void visitLetStmt(Let &stmt);
+    void visitBlockStmt(Block &stmt);
+    void visitIfStmt(If &stmt);
+    void visitWhileStmt(While &stmt);
+    void visitFunctionStmt(Function &stmt);
+    void visitClassStmt(Class &stmt);
+    void visitReturnStmt(Return &stmt);
 };
+
+enum class AstFormat { Text, Json, Sexpr };
+
+// AST dumps for people and for tools. Text is AstPrinter's one line per statement. Json is one line per
+// file, {"file": ..., "statements": [...]}, with a {"kind": ..., <fields>} object per node. Sexpr is a
+// "; <file>" comment followed by one (Kind <fields>...) list per statement.
+namespace AstDump {
+std::optional<AstFormat> parseFormat(std::string_view name);
+void print(std::ostream &out, Program &program, AstFormat format);
+} // namespace AstDump
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "arena.hpp"
+#include "ast.hpp"
+#include "token_stream.hpp"
+
+// The result of parsing a file: the top-level statements, the arena that owns every node under them and the
+// token stream they were parsed from.
+class Program {
+  public:
+    std::unique_ptr<AstArena> arena;
+    std::vector<StmtPtr> statements;
+    std::shared_ptr<const TokenStream> tokens;
+
+    Program() : arena(std::make_unique<AstArena>()) {}
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Static type of a value. Nodes start out Unknown and the type checker (see sema/) fills them in.
+enum class Type : uint8_t { Unknown, Int, Float, Bool, String, Void };
+
+namespace Types {
+inline const char *name(Type type) {
+    switch (type) {
+    case Type::Int: return "int";
+    case Type::Float: return "float";
+    case Type::Bool: return "bool";
+    case Type::String: return "string";
+    case Type::Void: return "void";
+    default: return "unknown";
+    }
+}
+
+// The type a `: name` annotation refers to
+inline std::optional<Type> fromName(std::string_view name) {
+    if (name == "int") return Type::Int;
+    if (name == "float") return Type::Float;
+    if (name == "bool") return Type::Bool;
+    if (name == "string") return Type::String;
+    if (name == "void") return Type::Void;
+    return std::nullopt;
+}
+} // namespace Types
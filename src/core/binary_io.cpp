@@ -0,0 +1,88 @@
+#include "binary_io.hpp"
+
+namespace {
+// Which alternative of an Object follows, as written on disk
+enum class ObjectTag : uint8_t { Int, Double, String, Bool, Identifier };
+} // namespace
+
+void BinaryWriter::symbol(Symbol symbol) {
+    auto [it, inserted] = symbolIndex.try_emplace(symbol, static_cast<uint32_t>(symbols.size()));
+    if (inserted) symbols.push_back(symbol);
+    varint(it->second);
+}
+
+void BinaryWriter::object(const Object &object) {
+    std::visit(
+        [&](auto &&val) {
+            using T = std::decay_t<decltype(val)>;
+            if constexpr (std::is_same_v<T, int>) {
+                value(ObjectTag::Int);
+                signedVarint(val);
+            } else if constexpr (std::is_same_v<T, double>) {
+                value(ObjectTag::Double);
+                value(val);
+            } else if constexpr (std::is_same_v<T, StringLiteral>) {
+                value(ObjectTag::String);
+                symbol(val.id);
+            } else if constexpr (std::is_same_v<T, bool>) {
+                value(ObjectTag::Bool);
+                value(val);
+            } else {
+                value(ObjectTag::Identifier);
+                symbol(val.id);
+            }
+        },
+        object);
+}
+
+Symbol BinaryReader::symbol() {
+    uint64_t index = varint();
+    if (index >= symbols.size()) {
+        fail();
+        return 0;
+    }
+    return symbols[index];
+}
+
+Object BinaryReader::object() {
+    switch (value<ObjectTag>()) {
+    case ObjectTag::Int: return static_cast<int>(signedVarint());
+    case ObjectTag::Double: return value<double>();
+    case ObjectTag::String: return StringLiteral{symbol()};
+    case ObjectTag::Bool: {
+        uint8_t byte = value<uint8_t>();
+        if (byte > 1) break;
+        return byte == 1;
+    }
+    case ObjectTag::Identifier: return Identifier{symbol()};
+    }
+    fail();
+    return 0;
+}
+
+namespace BinaryIO {
+uint64_t hash(std::string_view data, uint64_t seed) {
+    constexpr uint64_t MULTIPLIER = 0x9e3779b97f4a7c15ull;
+
+    uint64_t hash = seed ^ data.size() * MULTIPLIER;
+    size_t i = 0;
+    for (; i + 8 <= data.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data.data() + i, 8);
+        hash = (hash ^ word) * MULTIPLIER;
+        hash ^= hash >> 29;
+    }
+    uint64_t tail = 0;
+    // Nothing is left to copy for empty input, whose data() may be null
+    if (i < data.size()) std::memcpy(&tail, data.data() + i, data.size() - i);
+    hash = (hash ^ tail) * MULTIPLIER;
+
+    // MurmurHash3's finalizer, so every input bit affects every output bit
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+} // namespace BinaryIO
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "symbols.hpp"
+#include "tokens.hpp"
+
+// A minimal binary format for on-disk caches. Fixed-size values are copied as they are laid out in memory,
+// so a blob is only meant to be read back by the same build of the compiler on the same machine.
+//
+// Symbol ids are only meaningful within one process, so symbols are written as indices into a table of
+// their names; whoever writes the blob stores getSymbols() ahead of it and hands the re-interned ids to the
+// reader with setSymbols().
+class BinaryWriter {
+  public:
+    template <typename T> void value(const T &v) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        buffer.append(reinterpret_cast<const char *>(&v), sizeof(T));
+    }
+    void string(std::string_view s) {
+        varint(s.size());
+        buffer.append(s);
+    }
+    // LEB128: small numbers, like deltas between neighbouring tokens, take a single byte
+    void varint(uint64_t v) {
+        while (v >= 0x80) {
+            buffer.push_back(static_cast<char>(v | 0x80));
+            v >>= 7;
+        }
+        buffer.push_back(static_cast<char>(v));
+    }
+    void signedVarint(int64_t v) { varint((static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63)); }
+    // Appends already encoded data, e.g. another writer's buffer
+    void bytes(std::string_view s) { buffer.append(s); }
+    void symbol(Symbol symbol);
+    void object(const Object &object);
+
+    const std::vector<Symbol> &getSymbols() const { return symbols; }
+    const std::string &getBuffer() const { return buffer; }
+
+  private:
+    std::string buffer;
+    std::vector<Symbol> symbols;
+    std::unordered_map<Symbol, uint32_t> symbolIndex;
+};
+
+// Reads what a BinaryWriter wrote. Reading past the end or a malformed value sets a sticky failure flag and
+// yields zeroes, so a caller checks ok() once at the end instead of after every read.
+class BinaryReader {
+  public:
+    explicit BinaryReader(std::string_view data) : data(data) {}
+
+    template <typename T> T value() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T v{};
+        if (!take(sizeof(T))) return v;
+        std::memcpy(&v, data.data() + position - sizeof(T), sizeof(T));
+        return v;
+    }
+    uint64_t varint() {
+        if (!failed && position < data.size() && static_cast<uint8_t>(data[position]) < 0x80) {
+            return static_cast<uint8_t>(data[position++]);
+        }
+        uint64_t v = 0;
+        for (unsigned shift = 0; shift < 64 && take(1); shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(data[position - 1]);
+            v |= uint64_t{byte & 0x7fu} << shift;
+            if (byte < 0x80) return v;
+        }
+        fail();
+        return 0;
+    }
+    int64_t signedVarint() {
+        uint64_t v = varint();
+        return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+    }
+    std::string_view string() {
+        uint64_t size = varint();
+        if (!take(size)) return {};
+        return data.substr(position - size, size);
+    }
+    Symbol symbol();
+    Object object();
+
+    void setSymbols(std::vector<Symbol> symbols) { this->symbols = std::move(symbols); }
+    void fail() { failed = true; }
+    bool ok() const { return !failed; }
+    bool atEnd() const { return position == data.size(); }
+
+  private:
+    std::string_view data;
+    size_t position = 0;
+    bool failed = false;
+    std::vector<Symbol> symbols;
+
+    bool take(uint64_t size) {
+        if (failed || size > data.size() - position) {
+            failed = true;
+            return false;
+        }
+        position += size;
+        return true;
+    }
+};
+
+namespace BinaryIO {
+// Fast 64-bit hash that reads 8 bytes per step. Not cryptographic; pass the hash of one piece as the seed of
+// the next to hash several pieces as one.
+uint64_t hash(std::string_view data, uint64_t seed = 0);
+} // namespace BinaryIO
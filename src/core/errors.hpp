@@ -1,9 +1,43 @@
 #pragma once
 
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
 #include <sysexits.h>
 
+#include "source.hpp"
+#include "tokens.hpp"
+
+// A compile error at a source location. Passes collect these instead of throwing, and the driver prints
+// them all at once.
+struct Diagnostic {
+    FileId fileId;
+    int line;
+    int col;
+    std::string where; // e.g. "at 'foo'" or "at end"
+    std::string message;
+};
+
 namespace Errors {
 inline void report(int line, std::string where, std::string message) {
     std::cerr << "[line " << line << "] Error" << where << ": " << message;
 }
+
+inline Diagnostic at(const Token &token, std::string message) {
+    std::string where =
+        token.tokenType == TokenType::T_EOF ? "at end" : "at '" + std::string(token.lexeme) + "'";
+    return Diagnostic{token.fileId, token.line, token.col, std::move(where), std::move(message)};
+}
+
+// Formats every diagnostic first and writes them in one go
+inline void print(std::ostream &out, const std::vector<Diagnostic> &diagnostics) {
+    std::ostringstream buffer;
+    for (const Diagnostic &diagnostic : diagnostics) {
+        buffer << Sources::get(diagnostic.fileId).getName() << ":" << diagnostic.line << ":" << diagnostic.col
+               << " " << diagnostic.where << ": error: " << diagnostic.message << '\n';
+    }
+    out << buffer.str() << std::flush;
+}
 } // namespace Errors
@@ -0,0 +1,96 @@
+#include "source.hpp"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceFile::~SourceFile() {
+    if (mapping) munmap(const_cast<char *>(mapping), text.size());
+}
+
+namespace Sources {
+namespace {
+std::mutex mutex;
+std::deque<std::unique_ptr<SourceFile>> files;
+std::vector<FileId> released; // Slots of files that were released, reused by the next ones added
+
+FileId push(std::unique_ptr<SourceFile> file) {
+    std::lock_guard lock(mutex);
+    if (!released.empty()) {
+        FileId id = released.back();
+        released.pop_back();
+        files[id] = std::move(file);
+        return id;
+    }
+    files.push_back(std::move(file));
+    return static_cast<FileId>(files.size() - 1);
+}
+
+std::unique_ptr<SourceFile> map(const std::string &path, int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) return nullptr;
+
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE; // Fault the whole file in at once, the lexer reads all of it anyway
+#endif
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, flags, fd, 0);
+    if (addr == MAP_FAILED) return nullptr;
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+
+    return std::make_unique<SourceFile>(path, static_cast<const char *>(addr), st.st_size);
+}
+
+std::unique_ptr<SourceFile> read(const std::string &path, int fd) {
+    std::string text;
+    char chunk[1 << 16];
+    ssize_t n;
+    while ((n = ::read(fd, chunk, sizeof(chunk))) != 0) {
+        if (n < 0) return nullptr;
+        text.append(chunk, n);
+    }
+
+    return std::make_unique<SourceFile>(path, std::move(text));
+}
+} // namespace
+
+FileId add(std::string name, std::string text) {
+    return push(std::make_unique<SourceFile>(std::move(name), std::move(text)));
+}
+
+std::unique_ptr<SourceFile> open(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+
+    std::unique_ptr<SourceFile> file = map(path, fd);
+    if (!file) file = read(path, fd);
+    close(fd);
+    return file;
+}
+
+std::optional<FileId> load(const std::string &path) {
+    std::unique_ptr<SourceFile> file = open(path);
+    if (!file) return std::nullopt;
+    return push(std::move(file));
+}
+
+const SourceFile &get(FileId id) {
+    std::lock_guard lock(mutex);
+    return *files.at(id);
+}
+
+void release(FileId id) {
+    std::unique_ptr<SourceFile> file;
+    {
+        std::lock_guard lock(mutex);
+        file = std::move(files.at(id));
+        if (file) released.push_back(id);
+    }
+}
+} // namespace Sources
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+using FileId = uint32_t;
+
+// A loaded source file. Tokens keep views into `text`, so a SourceFile must outlive every token lexed
+// from it; the Sources registry keeps them alive for the whole process.
+//
+// The text is either owned or, for regular files, a read-only memory mapping of the file.
+class SourceFile {
+  public:
+    SourceFile(std::string name, std::string text) : name(std::move(name)), owned(std::move(text)) {
+        this->text = owned;
+    }
+    SourceFile(std::string name, const char *mapping, size_t size)
+        : name(std::move(name)), mapping(mapping), text(mapping, size) {}
+    SourceFile(const SourceFile &) = delete;
+    SourceFile &operator=(const SourceFile &) = delete;
+    ~SourceFile();
+
+    const std::string &getName() const { return name; }
+    std::string_view getText() const { return text; }
+
+  private:
+    std::string name;
+    std::string owned;
+    const char *mapping = nullptr;
+    std::string_view text;
+};
+
+namespace Sources {
+FileId add(std::string name, std::string text);
+// Reads a file like load() without registering it, for data that nothing keeps views into
+std::unique_ptr<SourceFile> open(const std::string &path);
+// Maps `path` into memory, falling back to reading it when it cannot be mapped (pipes, character devices).
+std::optional<FileId> load(const std::string &path);
+const SourceFile &get(FileId id);
+// Frees a file nothing refers to any more. Its id must not be used afterwards: the next file added gets it.
+void release(FileId id);
+} // namespace Sources
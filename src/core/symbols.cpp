@@ -0,0 +1,34 @@
+#include "symbols.hpp"
+
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+namespace Symbols {
+namespace {
+std::shared_mutex mutex;
+std::deque<std::string> names; // deque: interned strings never move, so the map keys can view them
+std::unordered_map<std::string_view, Symbol> ids;
+} // namespace
+
+Symbol intern(std::string_view text) {
+    {
+        std::shared_lock lock(mutex);
+        if (auto it = ids.find(text); it != ids.end()) return it->second;
+    }
+
+    std::unique_lock lock(mutex);
+    if (auto it = ids.find(text); it != ids.end()) return it->second;
+
+    Symbol symbol = static_cast<Symbol>(names.size());
+    ids.emplace(names.emplace_back(text), symbol);
+    return symbol;
+}
+
+std::string_view name(Symbol symbol) {
+    std::shared_lock lock(mutex);
+    return names.at(symbol);
+}
+} // namespace Symbols
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// Dense id of an interned identifier or string literal. Equal texts always get the same id, so later
+// stages compare and hash symbols instead of strings.
+using Symbol = uint32_t;
+
+namespace Symbols {
+Symbol intern(std::string_view text);
+// The returned view stays valid for the whole process.
+std::string_view name(Symbol symbol);
+} // namespace Symbols
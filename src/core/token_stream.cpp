@@ -0,0 +1,157 @@
+#include "token_stream.hpp"
+
+#include <algorithm>
+#include <span>
+
+static bool hasLiteral(TokenType type) {
+    switch (type) {
+    case NUMBER:
+    case STRING:
+    case IDENTIFIER:
+    case TRUE:
+    case FALSE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void TokenStream::push(const Token &token) {
+    types.push_back(token.tokenType);
+    offsets.push_back(static_cast<uint32_t>(token.lexeme.data() - text.data()));
+    lengths.push_back(static_cast<uint32_t>(token.lexeme.size()));
+    lines.push_back(token.line);
+    cols.push_back(token.col);
+
+    if (hasLiteral(token.tokenType)) {
+        literals.push_back(static_cast<uint32_t>(values.size()));
+        values.push_back(token.literal);
+    } else {
+        literals.push_back(NO_LITERAL);
+    }
+}
+
+void TokenStream::reserve(size_t count) {
+    types.reserve(count);
+    offsets.reserve(count);
+    lengths.reserve(count);
+    literals.reserve(count);
+    lines.reserve(count);
+    cols.reserve(count);
+}
+
+// Replaces v[first, last) with `with`, moving the tail of `v` only once
+template <typename T>
+static void replaceRange(std::vector<T> &v, size_t first, size_t last, std::span<const T> with) {
+    if (with.size() > last - first) {
+        v.insert(v.begin() + last, with.size() - (last - first), T{});
+    } else {
+        v.erase(v.begin() + first + with.size(), v.begin() + last);
+    }
+    std::copy(with.begin(), with.end(), v.begin() + first);
+}
+
+void TokenStream::replace(size_t first, size_t last, const TokenStream &other, size_t otherFirst,
+                          size_t otherLast, int64_t offsetShift, int lineShift) {
+    text = other.text;
+    fileId = other.fileId;
+
+    // The literals of a run of tokens are a contiguous run of `values`, so they are replaced as one block
+    auto literalRange = [](const TokenStream &stream, size_t first, size_t last) {
+        while (first < last && stream.literals[first] == NO_LITERAL) first++;
+        while (last > first && stream.literals[last - 1] == NO_LITERAL) last--;
+        if (first == last) return std::pair<size_t, size_t>(0, 0);
+        return std::pair<size_t, size_t>(stream.literals[first], stream.literals[last - 1] + 1);
+    };
+    auto [oldBegin, oldEnd] = literalRange(*this, first, last);
+    auto [newBegin, newEnd] = literalRange(other, otherFirst, otherLast);
+    if (oldBegin == oldEnd) {
+        // No literal to replace: insert before the first literal after the range
+        size_t next = last;
+        while (next < size() && literals[next] == NO_LITERAL) next++;
+        oldBegin = oldEnd = next < size() ? literals[next] : values.size();
+    }
+    replaceRange(values, oldBegin, oldEnd, std::span(other.values).subspan(newBegin, newEnd - newBegin));
+    int64_t literalShift = static_cast<int64_t>(newEnd - newBegin) - static_cast<int64_t>(oldEnd - oldBegin);
+
+    size_t inserted = otherLast - otherFirst;
+    replaceRange(types, first, last, std::span(other.types).subspan(otherFirst, inserted));
+    replaceRange(offsets, first, last, std::span(other.offsets).subspan(otherFirst, inserted));
+    replaceRange(lengths, first, last, std::span(other.lengths).subspan(otherFirst, inserted));
+    replaceRange(literals, first, last, std::span(other.literals).subspan(otherFirst, inserted));
+    replaceRange(lines, first, last, std::span(other.lines).subspan(otherFirst, inserted));
+    replaceRange(cols, first, last, std::span(other.cols).subspan(otherFirst, inserted));
+
+    for (size_t i = first; i < first + inserted; i++) {
+        if (literals[i] != NO_LITERAL) literals[i] = static_cast<uint32_t>(literals[i] - newBegin + oldBegin);
+    }
+    for (size_t i = first + inserted; i < size(); i++) {
+        offsets[i] = static_cast<uint32_t>(offsets[i] + offsetShift);
+        lines[i] = static_cast<uint32_t>(static_cast<int64_t>(lines[i]) + lineShift);
+        if (literals[i] != NO_LITERAL) literals[i] = static_cast<uint32_t>(literals[i] + literalShift);
+    }
+}
+
+Token TokenStream::at(size_t i) const {
+    Object literal = literals[i] == NO_LITERAL ? Object{} : values[literals[i]];
+    return Token(types[i], text.substr(offsets[i], lengths[i]), literal, fileId, lines[i], cols[i],
+                 static_cast<uint32_t>(i));
+}
+
+// Each token is written relative to the one before it: the gap since its end, its length, the lines since
+// its line and its column, which are mostly single bytes, followed by its literal if its type has one.
+void TokenStream::write(BinaryWriter &out) const {
+    out.varint(size());
+    int64_t previousEnd = 0;
+    int64_t previousLine = 1;
+    for (size_t i = 0; i < size(); i++) {
+        out.value(static_cast<int8_t>(types[i]));
+        out.signedVarint(offsets[i] - previousEnd);
+        out.varint(lengths[i]);
+        out.signedVarint(lines[i] - previousLine);
+        out.varint(cols[i]);
+        if (hasLiteral(types[i])) out.object(values[literals[i]]);
+
+        previousEnd = end(i);
+        previousLine = lines[i];
+    }
+}
+
+std::optional<TokenStream> TokenStream::read(BinaryReader &in, FileId fileId, std::string_view text) {
+    TokenStream stream{fileId, text};
+    uint64_t count = in.varint();
+    stream.reserve(std::min<uint64_t>(count, text.size() + 1)); // Tokens are not empty, apart from T_EOF
+
+    int64_t previousEnd = 0;
+    int64_t previousLine = 1;
+    for (uint64_t i = 0; i < count && in.ok(); i++) {
+        int8_t rawType = in.value<int8_t>();
+        if (rawType < ERROR || rawType > T_EOF) return std::nullopt;
+        auto type = static_cast<TokenType>(rawType);
+        int64_t offset = previousEnd + in.signedVarint();
+        uint64_t length = in.varint();
+        int64_t line = previousLine + in.signedVarint();
+        uint64_t col = in.varint();
+        bool fits = offset >= 0 && offset + length <= text.size() && line >= 0 && line <= UINT32_MAX;
+        if (!fits || col > UINT32_MAX) return std::nullopt;
+
+        stream.types.push_back(type);
+        stream.offsets.push_back(static_cast<uint32_t>(offset));
+        stream.lengths.push_back(static_cast<uint32_t>(length));
+        stream.lines.push_back(static_cast<uint32_t>(line));
+        stream.cols.push_back(static_cast<uint32_t>(col));
+        if (hasLiteral(type)) {
+            stream.literals.push_back(static_cast<uint32_t>(stream.values.size()));
+            stream.values.push_back(in.object());
+        } else {
+            stream.literals.push_back(NO_LITERAL);
+        }
+
+        previousEnd = offset + static_cast<int64_t>(length);
+        previousLine = line;
+    }
+
+    // The parser and the passes after it rely on the stream ending at T_EOF
+    if (!in.ok() || stream.types.empty() || stream.types.back() != T_EOF) return std::nullopt;
+    return stream;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "binary_io.hpp"
+#include "tokens.hpp"
+
+// A lexed file stored as a structure of arrays. The parser indexes into it, so any amount of lookahead is
+// O(1) and walking the token types touches one dense array instead of whole Token objects.
+class TokenStream {
+  public:
+    static constexpr uint32_t NO_LITERAL = UINT32_MAX;
+
+    TokenStream(FileId fileId, std::string_view text) : fileId(fileId), text(text) {}
+
+    void push(const Token &token);
+    void reserve(size_t count);
+    // Replaces tokens [first, last) with tokens [otherFirst, otherLast) of `other` and moves the tokens after
+    // them by `offsetShift` bytes and `lineShift` lines. Afterwards the stream refers to `other`'s text,
+    // which must agree with the old one on every token that was kept.
+    void replace(size_t first, size_t last, const TokenStream &other, size_t otherFirst, size_t otherLast,
+                 int64_t offsetShift, int lineShift);
+
+    // Writes everything but the text. read() takes the text back, which must be the same bytes the tokens
+    // were lexed from; it returns nullopt if the tokens do not fit in it or are not valid tokens.
+    void write(BinaryWriter &out) const;
+    static std::optional<TokenStream> read(BinaryReader &in, FileId fileId, std::string_view text);
+
+    size_t size() const { return types.size(); }
+    bool empty() const { return types.empty(); }
+    TokenType type(size_t i) const { return types[i]; }
+    uint32_t offset(size_t i) const { return offsets[i]; }
+    uint32_t end(size_t i) const { return offsets[i] + lengths[i]; } // Offset just past token `i`
+    int line(size_t i) const { return static_cast<int>(lines[i]); }
+    int col(size_t i) const { return static_cast<int>(cols[i]); }
+    Token at(size_t i) const;
+
+    FileId getFileId() const { return fileId; }
+    std::string_view getText() const { return text; }
+
+  private:
+    FileId fileId;
+    std::string_view text;
+
+    std::vector<TokenType> types;
+    std::vector<uint32_t> offsets; // Into `text`
+    std::vector<uint32_t> lengths;
+    std::vector<uint32_t> literals; // Into `values`, or NO_LITERAL
+    std::vector<uint32_t> lines;
+    std::vector<uint32_t> cols;
+
+    std::vector<Object> values;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <string_view>
 #include <unordered_map>
 #include <variant>
 
@@ -8,22 +9,29 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 
+#include "source.hpp"
+#include "symbols.hpp"
+
 struct Identifier {
-    std::string id;
+    Symbol id;
+};
+
+struct StringLiteral {
+    Symbol id;
 };
 
-using Object = std::variant<int, double, std::string, bool, struct Identifier>;
+using Object = std::variant<int, double, StringLiteral, bool, struct Identifier>;
 
 inline std::ostream &operator<<(std::ostream &os, const Object &obj) {
     std::visit(
         [&os](auto &&val) {
             using T = std::decay_t<decltype(val)>;
-            if constexpr (std::is_same_v<T, std::string>) {
-                os << "\"" << val << "\"";
+            if constexpr (std::is_same_v<T, StringLiteral>) {
+                os << "\"" << Symbols::name(val.id) << "\"";
             } else if constexpr (std::is_same_v<T, bool>) {
                 os << (val ? "true" : "false");
             } else if constexpr (std::is_same_v<T, struct Identifier>) {
-                os << val.id;
+                os << Symbols::name(val.id);
             } else {
                 os << val;
             }
@@ -205,20 +213,28 @@ inline const char *TokenTypeName(TokenType type) {
     }
 }
 
+// Tokens are small value types: the lexeme is a view into the SourceFile buffer and the filename is looked
+// up through the file id, so copying a token never allocates.
 class Token {
   public:
     TokenType tokenType;
-    std::string lexeme;
+    std::string_view lexeme;
     Object literal;
 
-    std::string filename;
+    FileId fileId;
     int line;
     int col;
+    uint32_t index; // Position in the TokenStream the token was read from
+
+    Token() : tokenType(TokenType::T_SOF), lexeme("T_SOF"), literal(0), fileId(0), line(0), col(0), index(0) {}
+    Token(TokenType type, std::string_view lexeme, Object literal, FileId fileId, int line, int col,
+          uint32_t index = 0)
+        : tokenType(type), lexeme(lexeme), literal(std::move(literal)), fileId(fileId), line(line), col(col),
+          index(index) {}
 
-    Token() : tokenType(TokenType::T_SOF), lexeme("T_SOF"), literal("T_SOF"), line(0) {}
-    Token(TokenType type, std::string lexeme, Object literal, std::string filename, int line, int col)
-        : tokenType(type), lexeme(lexeme), literal(literal), filename(filename), line(line), col(col) {}
-    ~Token() {};
+    const std::string &filename() const { return Sources::get(fileId).getName(); }
+    // Only meaningful for IDENTIFIER tokens
+    Symbol symbol() const { return std::get<Identifier>(literal).id; }
 
     inline friend std::ostream &operator<<(std::ostream &os, const Token &t) {
         os << TokenTypeName(t.tokenType) << " " << t.lexeme << " " << t.literal << " " << t.line << ":"
@@ -1,7 +1,81 @@
 #include "lexer.hpp"
 
-#include <sstream>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iterator>
+
+static FileId load(std::istream &input, std::string filename) {
+    std::string text{std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+    return Sources::add(std::move(filename), std::move(text));
+}
+
+Lexer::Lexer(FileId fileId)
+    : fileId(fileId), source(Sources::get(fileId)), scanner(fileId, source.getText()) {}
+
+Lexer::Lexer(std::istream &input, std::string filename) : Lexer(load(input, std::move(filename))) {}
+
+Lexer::Lexer(FileId fileId, size_t offset, int line, int col)
+    : fileId(fileId), source(Sources::get(fileId)), scanner(fileId, source.getText(), offset, line, col) {}
 
 int Lexer::nextToken() {
     return scanner.yylex();
 }
+
+void Lexer::tokenize(TokenStream &out) {
+    out.reserve(out.size() + source.getText().size() / 8);
+    while (scanner.yylex() != TokenType::T_EOF) out.push(scanner.token);
+    out.push(scanner.token);
+}
+
+#ifndef MARBL_HANDWRITTEN_LEXER
+int Lexer::Scanner::LexerInput(char *buf, int max_size) {
+    size_t n = std::min(static_cast<size_t>(max_size), text.size() - position);
+    std::memcpy(buf, text.data() + position, n);
+    position += n;
+    return static_cast<int>(n);
+}
+#endif
+
+std::optional<Object> Lexer::parseNumber(std::string_view text) {
+    const char *end = text.data() + text.size();
+    if (text.find('.') != std::string_view::npos) {
+        double value = 0;
+        auto [last, ec] = std::from_chars(text.data(), end, value);
+        if (ec != std::errc() || last != end) return std::nullopt;
+        return value;
+    }
+    int value = 0;
+    auto [last, ec] = std::from_chars(text.data(), end, value);
+    if (ec != std::errc() || last != end) return std::nullopt;
+    return value;
+}
+
+static std::string unescape(std::string_view str) {
+    std::string result;
+    result.reserve(str.size());
+
+    for (size_t i = 0; i < str.size(); ++i) {
+        if (str[i] == '\\' && i + 1 < str.size()) {
+            char next = str[i + 1];
+            switch (next) {
+                case 'n': result.push_back('\n'); break;
+                case 't': result.push_back('\t'); break;
+                case 'r': result.push_back('\r'); break;
+                case '"': result.push_back('"'); break;
+                case '\\': result.push_back('\\'); break;
+                default: result.push_back(next); break;
+            }
+            ++i; // skip the escaped char
+        } else {
+            result.push_back(str[i]);
+        }
+    }
+
+    return result;
+}
+
+Symbol Lexer::internString(std::string_view raw) {
+    if (raw.find('\\') == std::string_view::npos) return Symbols::intern(raw);
+    return Symbols::intern(unescape(raw));
+}
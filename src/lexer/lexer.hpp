@@ -1,27 +1,95 @@
 #pragma once
 
-#ifndef __FLEX_LEXER_H
-    #include <FlexLexer.h>
+#ifndef MARBL_HANDWRITTEN_LEXER
+    #ifndef __FLEX_LEXER_H
+        #include <FlexLexer.h>
+    #endif
 #endif
 
+#include <optional>
 #include <string>
 #include <vector>
 
+#include "source.hpp"
+#include "token_stream.hpp"
 #include "tokens.hpp"
 
+// All scanning state lives in the Lexer instance, so several lexers can run concurrently on different
+// threads and each file starts counting lines from 1.
 class Lexer {
   public:
-    inline static Token currentToken{};
-    inline static Lexer *activeLexer = nullptr;
-
-    Lexer(std::istream &input, std::string filename) : scanner(&input), filename(filename) {
-        activeLexer = this;
-    }
+    explicit Lexer(FileId fileId);
+    Lexer(std::istream &input, std::string filename);
+    // Starts at byte `offset` of the file, which must be the start of a token or of the blanks before one
+    Lexer(FileId fileId, size_t offset, int line, int col);
 
     int nextToken();
-    const std::string &getFilename() const { return filename; }
+    // Lexes everything that is left, up to and including T_EOF, into `out`
+    void tokenize(TokenStream &out);
+
+    const Token &currentToken() const { return scanner.token; }
+    const std::string &getFilename() const { return source.getName(); }
+    FileId getFileId() const { return fileId; }
+    std::string_view getText() const { return source.getText(); }
 
   private:
-    yyFlexLexer scanner;
-    std::string filename;
+    // Literal conversions shared by both scanners, so they agree on every value. A number that does not fit
+    // its type is nullopt, and the scanners turn it into an ERROR token the parser reports.
+    static std::optional<Object> parseNumber(std::string_view text);
+    static Symbol internString(std::string_view raw);
+
+#ifdef MARBL_HANDWRITTEN_LEXER
+    // The hand-written scanner (scanner.cpp), reading the SourceFile buffer in place.
+    class Scanner final {
+      public:
+        Token token{};
+
+        Scanner(FileId fileId, std::string_view text, size_t offset = 0, int line = 1, int col = 1)
+            : fileId(fileId), text(text), line(line), col(col), offset(offset) {}
+
+        int yylex();
+
+      private:
+        FileId fileId;
+        std::string_view text;
+
+        // Position of the next token
+        int line = 1;
+        int col = 1;
+        size_t offset = 0;
+
+        int emit(TokenType type, size_t length, Object literal = {});
+        int number(size_t length);
+        int word(size_t length);
+    };
+#else
+    // The flex scanner (see `%option yyclass` in lexer.l). It is fed straight from the SourceFile buffer
+    // instead of an istream.
+    class Scanner final : public yyFlexLexer {
+      public:
+        Token token{};
+
+        Scanner(FileId fileId, std::string_view text, size_t offset = 0, int line = 1, int col = 1)
+            : fileId(fileId), text(text), position(offset), line(line), col(col), offset(offset) {}
+
+        int yylex() override;
+
+      protected:
+        int LexerInput(char *buf, int max_size) override;
+
+      private:
+        FileId fileId;
+        std::string_view text;
+        size_t position = 0; // How far flex has read into `text`
+
+        // Position of the next token
+        int line = 1;
+        int col = 1;
+        size_t offset = 0;
+    };
+#endif
+
+    FileId fileId;
+    const SourceFile &source;
+    Scanner scanner;
 };
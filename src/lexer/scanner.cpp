@@ -0,0 +1,257 @@
+// Hand-written replacement for the flex rules in lexer.l, enabled with -DMARBL_HANDWRITTEN_LEXER=ON.
+//
+// It must produce exactly the token stream lexer.l produces, including its odd corners: identifiers are
+// letters and digits only, "" is not a string, a `//` comment needs a newline after it, and the longest
+// possible string literal wins (so `"a\"b"` is one string).
+
+#include "lexer.hpp"
+
+#include <array>
+#include <bit>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+namespace {
+// ======= Character runs =======
+// Each returns the first position in [p, end) that does not belong to the run (or `end`).
+
+inline bool isBlank(char c) { return c == ' ' || c == '\t'; }
+inline bool isLetter(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+inline bool isIdentifierChar(char c) { return isLetter(c) || isDigit(c); }
+
+const char *skipBlanks(const char *p, const char *end) {
+#if defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    for (; end - p >= 16; p += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab));
+        unsigned mask = ~_mm_movemask_epi8(blank) & 0xFFFF;
+        if (mask) return p + std::countr_zero(mask);
+    }
+#endif
+    while (p < end && isBlank(*p)) p++;
+    return p;
+}
+
+const char *skipIdentifier(const char *p, const char *end) {
+#if defined(__SSE2__)
+    // Bytes >= 0x80 are negative as signed chars, so they fall outside both ranges
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    const __m128i beforeA = _mm_set1_epi8('a' - 1);
+    const __m128i afterZ = _mm_set1_epi8('z' + 1);
+    const __m128i before0 = _mm_set1_epi8('0' - 1);
+    const __m128i after9 = _mm_set1_epi8('9' + 1);
+    for (; end - p >= 16; p += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i lower = _mm_or_si128(chunk, caseBit);
+        __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, beforeA), _mm_cmplt_epi8(lower, afterZ));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(chunk, before0), _mm_cmplt_epi8(chunk, after9));
+        unsigned mask = ~_mm_movemask_epi8(_mm_or_si128(letter, digit)) & 0xFFFF;
+        if (mask) return p + std::countr_zero(mask);
+    }
+#endif
+    while (p < end && isIdentifierChar(*p)) p++;
+    return p;
+}
+
+const char *find(const char *p, const char *end, char c) {
+#if defined(__SSE2__)
+    const __m128i needle = _mm_set1_epi8(c);
+    for (; end - p >= 16; p += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if (mask) return p + std::countr_zero(mask);
+    }
+#endif
+    while (p < end && *p != c) p++;
+    return p;
+}
+
+// {DIGIT}+\.?{DIGIT}* | {DIGIT}*\.{DIGIT}+
+size_t numberLength(const char *p, const char *end) {
+    const char *q = p;
+    while (q < end && isDigit(*q)) q++;
+    if (q < end && *q == '.') {
+        q++;
+        while (q < end && isDigit(*q)) q++;
+    }
+    return q - p;
+}
+
+// ======= Keywords =======
+// Perfect hash over the keyword set: no two keywords share a slot, so a lookup is one hash, one length
+// check and one compare.
+
+struct Keyword {
+    std::string_view text;
+    TokenType type;
+};
+
+constexpr Keyword keywords[] = {
+    {"print", PRINT}, {"class", CLASS}, {"super", SUPER}, {"this", THIS},   {"fn", FUN},
+    {"return", RETURN}, {"if", IF},     {"else", ELSE},   {"for", FOR},     {"while", WHILE},
+    {"and", AND},     {"or", OR},       {"false", FALSE}, {"true", TRUE},   {"let", LET},
+};
+
+constexpr size_t KEYWORD_SLOTS = 32;
+
+constexpr size_t keywordHash(std::string_view word) {
+    return (word.size() * 2 + static_cast<unsigned char>(word.front()) * 3 +
+            static_cast<unsigned char>(word.back())) &
+           (KEYWORD_SLOTS - 1);
+}
+
+constexpr std::array<Keyword, KEYWORD_SLOTS> makeKeywordTable() {
+    std::array<Keyword, KEYWORD_SLOTS> table{};
+    for (auto &slot : table) slot = {"", IDENTIFIER};
+    for (const Keyword &keyword : keywords) table[keywordHash(keyword.text)] = keyword;
+    return table;
+}
+
+constexpr std::array<Keyword, KEYWORD_SLOTS> keywordTable = makeKeywordTable();
+
+constexpr bool isPerfect() {
+    for (const Keyword &keyword : keywords) {
+        if (keywordTable[keywordHash(keyword.text)].text != keyword.text) return false;
+    }
+    return true;
+}
+static_assert(isPerfect(), "keyword hash has a collision, pick new coefficients");
+
+TokenType keywordType(std::string_view word) {
+    const Keyword &slot = keywordTable[keywordHash(word)];
+    return slot.text == word ? slot.type : IDENTIFIER;
+}
+} // namespace
+
+int Lexer::Scanner::emit(TokenType type, size_t length, Object literal) {
+    token.tokenType = type;
+    token.lexeme = text.substr(offset, length);
+    token.literal = literal;
+    token.fileId = fileId;
+    token.line = line;
+    token.col = col;
+    col += length;
+    offset += length;
+    return type;
+}
+
+int Lexer::Scanner::number(size_t length) {
+    std::optional<Object> value = Lexer::parseNumber(text.substr(offset, length));
+    return value ? emit(NUMBER, length, *value) : emit(ERROR, length);
+}
+
+int Lexer::Scanner::word(size_t length) {
+    std::string_view word = text.substr(offset, length);
+
+    switch (TokenType type = keywordType(word)) {
+    case IDENTIFIER:
+        return emit(IDENTIFIER, length, Identifier{Symbols::intern(word)});
+    case TRUE:
+        return emit(TRUE, length, true);
+    case FALSE:
+        return emit(FALSE, length, false);
+    default:
+        return emit(type, length);
+    }
+}
+
+int Lexer::Scanner::yylex() {
+    const char *base = text.data();
+    const char *end = base + text.size();
+
+    while (true) {
+        if (offset >= text.size()) return emit(T_EOF, 0);
+
+        const char *p = base + offset;
+        char next = p + 1 < end ? p[1] : '\0';
+
+        switch (*p) {
+        case ' ':
+        case '\t': {
+            size_t length = skipBlanks(p, end) - p;
+            col += length;
+            offset += length;
+            continue;
+        }
+
+        case '\r':
+            offset += next == '\n' ? 2 : 1;
+            line++;
+            col = 1;
+            continue;
+        case '\n':
+            offset++;
+            line++;
+            col = 1;
+            continue;
+
+        case '/':
+            if (next == '/') {
+                // `\/\/.*$`: only a comment when a newline follows; the newline itself is not part of it
+                const char *newline = find(p + 2, end, '\n');
+                if (newline != end) {
+                    offset = newline - base;
+                    continue;
+                }
+            }
+            return next == '=' ? emit(SLASH_EQUAL, 2) : emit(SLASH, 1);
+
+        case '(':
+            return emit(LEFT_PAREN, 1);
+        case ')':
+            return emit(RIGHT_PAREN, 1);
+        case '{':
+            return emit(LEFT_BRACE, 1);
+        case '}':
+            return emit(RIGHT_BRACE, 1);
+        case ',':
+            return emit(COMMA, 1);
+        case ':':
+            return emit(COLON, 1);
+        case ';':
+            return emit(SEMICOLON, 1);
+
+        case '-':
+            return next == '=' ? emit(MINUS_EQUAL, 2) : emit(MINUS, 1);
+        case '+':
+            return next == '=' ? emit(PLUS_EQUAL, 2) : emit(PLUS, 1);
+        case '*':
+            return next == '=' ? emit(STAR_EQUAL, 2) : emit(STAR, 1);
+        case '!':
+            return next == '=' ? emit(BANG_EQUAL, 2) : emit(BANG, 1);
+        case '<':
+            return next == '=' ? emit(LESS_EQUAL, 2) : emit(LESS, 1);
+        case '>':
+            return next == '=' ? emit(GREATER_EQUAL, 2) : emit(GREATER, 1);
+        case '=':
+            return next == '=' ? emit(EQUAL_EQUAL, 2) : emit(EQUAL, 1);
+
+        case '.':
+            if (!isDigit(next)) return emit(DOT, 1);
+            return number(numberLength(p, end)); // `.5`
+        case '"': {
+            // Longest match of `\"([^"]|\\.)+\"`: a quote directly after a backslash may be part of the
+            // string or end it, any other quote ends it, and the string cannot be empty.
+            const char *close = nullptr;
+            for (const char *q = p + 1; (q = find(q, end, '"')) != end; q++) {
+                if (q > p + 1) close = q;
+                if (q - 1 == p || q[-1] != '\\') break;
+            }
+            if (!close) return emit(ERROR, 1);
+
+            size_t length = close + 1 - p;
+            return emit(STRING, length, StringLiteral{Lexer::internString(text.substr(offset + 1, length - 2))});
+        }
+
+        default:
+            if (isDigit(*p)) return number(numberLength(p, end));
+            if (isLetter(*p)) return word(skipIdentifier(p + 1, end) - p);
+            return emit(ERROR, 1);
+        }
+    }
+}
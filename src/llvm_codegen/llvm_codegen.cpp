@@ -1,10 +1,18 @@
 #include "llvm_codegen.hpp"
 
+namespace {
+// The symbol of a top-level declaration of an interactive session. The slot tells apart redeclarations,
+// which the modules of earlier entries still refer to.
+std::string globalName(const Token &name, uint32_t slot) {
+    return std::string(name.lexeme) + "." + std::to_string(slot);
+}
+} // namespace
+
 llvm::Value *CodeGenVisitor::convertToi1(llvm::Value *value) {
     if (value->getType()->isIntegerTy(32)) {
-        return builder.CreateICmpNE(value, llvm::ConstantInt::get(context, llvm::APInt(32, 0)), "ifcond");
+        return builder.CreateICmpNE(value, llvm::ConstantInt::get(*context, llvm::APInt(32, 0)), "ifcond");
     } else if (value->getType()->isDoubleTy()) {
-        return builder.CreateFCmpONE(value, llvm::ConstantFP::get(context, llvm::APFloat(0.0)), "ifcond");
+        return builder.CreateFCmpONE(value, llvm::ConstantFP::get(*context, llvm::APFloat(0.0)), "ifcond");
     } else if (!value->getType()->isIntegerTy(1)) {
         throw std::runtime_error("Invalid if condition type");
     }
@@ -12,21 +20,54 @@ llvm::Value *CodeGenVisitor::convertToi1(llvm::Value *value) {
     return value;
 }
 
+llvm::Type *CodeGenVisitor::typeOf(Type type) {
+    switch (type) {
+    case Type::Int: return builder.getInt32Ty();
+    case Type::Float: return builder.getDoubleTy();
+    case Type::Bool: return builder.getInt1Ty();
+    case Type::String: return builder.getPtrTy();
+    case Type::Void: return builder.getVoidTy();
+    default: throw std::runtime_error("Value was not type checked");
+    }
+}
+
+llvm::FunctionType *CodeGenVisitor::functionType(Function &stmt) {
+    // Parameter and result types, as inferred by the type checker
+    std::vector<llvm::Type *> argTypes;
+    for (auto &param : stmt.params) { argTypes.push_back(typeOf(param.declaredType)); }
+    return llvm::FunctionType::get(typeOf(stmt.declaredType), argTypes, false);
+}
+
+llvm::Constant *CodeGenVisitor::stringConstant(std::string_view text) {
+    auto [it, inserted] = strings.try_emplace(text, nullptr);
+    if (inserted) it->second = builder.CreateGlobalStringPtr(text);
+    return it->second;
+}
+
+llvm::Value *CodeGenVisitor::stringsEqual(llvm::Value *left, llvm::Value *right) {
+    llvm::FunctionType *strcmpType =
+        llvm::FunctionType::get(builder.getInt32Ty(), {builder.getPtrTy(), builder.getPtrTy()}, false);
+    llvm::FunctionCallee strcmpFunc = module->getOrInsertFunction("strcmp", strcmpType);
+    llvm::Value *order = builder.CreateCall(strcmpFunc, {left, right}, "strcmptmp");
+    return builder.CreateICmpEQ(order, builder.getInt32(0), "streqtmp");
+}
+
 llvm::Value *CodeGenVisitor::visitLiteralExpr(Literal &expr) {
     return std::visit(
         [&](auto &&val) -> llvm::Value * {
             using T = std::decay_t<decltype(val)>;
-            if constexpr (std::is_same_v<T, int>)
-                return llvm::ConstantInt::get(context, llvm::APInt(32, val));
-            else if constexpr (std::is_same_v<T, double>)
-                return llvm::ConstantFP::get(context, llvm::APFloat(val));
+            if constexpr (std::is_same_v<T, int>) {
+                // An integer literal the type checker made a float, as in `let x: float = 1;`
+                if (expr.type == Type::Float)
+                    return llvm::ConstantFP::get(*context, llvm::APFloat(static_cast<double>(val)));
+                return llvm::ConstantInt::get(*context, llvm::APInt(32, val, true));
+            } else if constexpr (std::is_same_v<T, double>)
+                return llvm::ConstantFP::get(*context, llvm::APFloat(val));
             else if constexpr (std::is_same_v<T, bool>)
-                return llvm::ConstantInt::get(context, llvm::APInt(1, val));
-            else if constexpr (std::is_same_v<T, std::string>)
-                return builder.CreateGlobalStringPtr(val);
-            else if constexpr (std::is_same_v<T, struct Identifier>) {
-                return env->get(val.id);
-            } else {
+                return llvm::ConstantInt::get(*context, llvm::APInt(1, val));
+            else if constexpr (std::is_same_v<T, StringLiteral>)
+                return stringConstant(Symbols::name(val.id));
+            else {
                 throw std::runtime_error("Type not yet supported in codegen");
             }
         },
@@ -73,10 +114,12 @@ llvm::Value *CodeGenVisitor::visitBinaryExpr(Binary &expr) {
 
     case TokenType::EQUAL_EQUAL:
         if (L->getType()->isDoubleTy()) return builder.CreateFCmpOEQ(L, R, "eqtmp");
+        if (L->getType()->isPointerTy()) return stringsEqual(L, R);
         return builder.CreateICmpEQ(L, R, "eqtmp");
 
     case TokenType::BANG_EQUAL:
         if (L->getType()->isDoubleTy()) return builder.CreateFCmpONE(L, R, "netmp");
+        if (L->getType()->isPointerTy()) return builder.CreateNot(stringsEqual(L, R), "netmp");
         return builder.CreateICmpNE(L, R, "netmp");
 
     default:
@@ -108,7 +151,7 @@ llvm::Value *CodeGenVisitor::visitUnaryExpr(Unary &expr) {
         return builder.CreateNeg(R, "negtmp");
 
     case TokenType::BANG:
-        return builder.CreateNot(R, "nottmp");
+        return builder.CreateNot(convertToi1(R), "nottmp");
 
     default:
         throw std::runtime_error("Unsupported unary operator");
@@ -120,17 +163,20 @@ llvm::Value *CodeGenVisitor::visitGroupingExpr(Grouping &expr) {
 }
 
 llvm::Value *CodeGenVisitor::visitVariableExpr(Variable &expr) {
-    llvm::Value *val = env->get(expr.name.lexeme);
+    llvm::Value *val = env->get(expr.depth, expr.slot);
 
     if (auto *func = llvm::dyn_cast<llvm::Function>(val)) { return func; }
 
-    auto *ptrTy = llvm::cast<llvm::AllocaInst>(val)->getAllocatedType();
-    return builder.CreateLoad(ptrTy, val, expr.name.lexeme);
+    // A local, or a global of an interactive session
+    auto *alloca = llvm::dyn_cast<llvm::AllocaInst>(val);
+    llvm::Type *type =
+        alloca ? alloca->getAllocatedType() : llvm::cast<llvm::GlobalVariable>(val)->getValueType();
+    return builder.CreateLoad(type, val, expr.name.lexeme);
 }
 
 llvm::Value *CodeGenVisitor::visitAssignExpr(Assign &expr) {
     llvm::Value *value = expr.value->accept(*this);
-    env->assign(*this, expr.name.lexeme, value);
+    env->assign(*this, expr.depth, expr.slot, value);
     return value;
 }
 
@@ -146,9 +192,18 @@ llvm::Value *CodeGenVisitor::visitCallExpr(Call &expr) {
 
     auto *calleeFn = llvm::dyn_cast<llvm::Function>(calleeVal);
     if (!calleeFn) { throw std::runtime_error("Call target is not a function"); }
+
+    // Variadic arguments follow the C promotions
+    for (size_t i = calleeFn->arg_size(); i < args.size(); i++) {
+        if (args[i]->getType()->isIntegerTy(1)) args[i] = builder.CreateZExt(args[i], builder.getInt32Ty());
+    }
     return builder.CreateCall(calleeFn, args, calleeFn->getReturnType()->isVoidTy() ? "" : "calltmp");
 }
 
+llvm::Value *CodeGenVisitor::visitTypeAnnotationExpr(TypeAnnotation &) {
+    throw std::runtime_error("A type annotation has no value");
+}
+
 void CodeGenVisitor::visitExpressionStmt(Expression &stmt) {
     auto *res = stmt.expression->accept(*this);
 }
@@ -158,18 +213,20 @@ void CodeGenVisitor::visitPrintStmt(Print &stmt) {
 
     llvm::Value *formatStr = nullptr;
     if (res->getType()->isIntegerTy(32))
-        formatStr = builder.CreateGlobalStringPtr("%d\n");
-    else if (res->getType()->isIntegerTy(1))
-        formatStr = builder.CreateGlobalStringPtr("%d\n");
+        formatStr = stringConstant("%d\n");
+    else if (res->getType()->isIntegerTy(1)) {
+        formatStr = stringConstant("%d\n");
+        res = builder.CreateZExt(res, builder.getInt32Ty());
+    }
     else if (res->getType()->isDoubleTy())
-        formatStr = builder.CreateGlobalStringPtr("%f\n");
+        formatStr = stringConstant("%f\n");
     else if (res->getType()->isPointerTy())
-        formatStr = builder.CreateGlobalStringPtr("%s\n");
+        formatStr = stringConstant("%s\n");
     else { throw std::runtime_error("Unsupported type for printing ;-;"); }
 
     llvm::FunctionType *printfType =
         llvm::FunctionType::get(builder.getInt32Ty(), llvm::PointerType::get(builder.getInt8Ty(), 0), true);
-    llvm::FunctionCallee printfFunc = module.getOrInsertFunction("printf", printfType);
+    llvm::FunctionCallee printfFunc = module->getOrInsertFunction("printf", printfType);
     builder.CreateCall(printfFunc, {formatStr, res});
 }
 
@@ -182,10 +239,10 @@ void CodeGenVisitor::visitIfStmt(If &stmt) {
     llvm::Function *function = builder.GetInsertBlock()->getParent();
 
     // Create blocks with parent function
-    llvm::BasicBlock *thenBB = llvm::BasicBlock::Create(context, "then", function);
+    llvm::BasicBlock *thenBB = llvm::BasicBlock::Create(*context, "then", function);
     llvm::BasicBlock *elseBB =
-        stmt.elseBranch ? llvm::BasicBlock::Create(context, "else", function) : nullptr;
-    llvm::BasicBlock *endBB = llvm::BasicBlock::Create(context, "end", function);
+        stmt.elseBranch ? llvm::BasicBlock::Create(*context, "else", function) : nullptr;
+    llvm::BasicBlock *endBB = llvm::BasicBlock::Create(*context, "end", function);
 
     // Conditional branch
     if (elseBB)
@@ -215,9 +272,9 @@ void CodeGenVisitor::visitWhileStmt(While &stmt) {
     llvm::Function *function = builder.GetInsertBlock()->getParent();
 
     // Create blocks with parent function
-    llvm::BasicBlock *condBB = llvm::BasicBlock::Create(context, "whilecond", function);
-    llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(context, "whilebody", function);
-    llvm::BasicBlock *endBB = llvm::BasicBlock::Create(context, "whileend", function);
+    llvm::BasicBlock *condBB = llvm::BasicBlock::Create(*context, "whilecond", function);
+    llvm::BasicBlock *bodyBB = llvm::BasicBlock::Create(*context, "whilebody", function);
+    llvm::BasicBlock *endBB = llvm::BasicBlock::Create(*context, "whileend", function);
 
     builder.CreateBr(condBB); // Jump to conditional branch
 
@@ -239,8 +296,20 @@ void CodeGenVisitor::visitWhileStmt(While &stmt) {
 }
 
 void CodeGenVisitor::visitLetStmt(Let &stmt) {
-    llvm::Value *value = stmt.initializer->accept(*this);
-    env->declare(*this, stmt.name.lexeme, value);
+    llvm::Type *type = typeOf(stmt.declaredType);
+    // `let x;` starts out as zero
+    llvm::Value *value =
+        stmt.initializer ? stmt.initializer->accept(*this) : llvm::Constant::getNullValue(type);
+
+    if (interactive && env->isTopLevel()) {
+        auto *global = new llvm::GlobalVariable(*module, type, false, llvm::GlobalValue::ExternalLinkage,
+                                                llvm::Constant::getNullValue(type),
+                                                globalName(stmt.name, stmt.slot));
+        builder.CreateStore(value, global);
+        env->bind(stmt.slot, global);
+        return;
+    }
+    env->declare(*this, stmt.slot, stmt.name.lexeme, type, value);
 }
 
 void CodeGenVisitor::visitBlockStmt(Block &stmt) {
@@ -251,29 +320,29 @@ void CodeGenVisitor::visitBlockStmt(Block &stmt) {
 }
 
 void CodeGenVisitor::visitFunctionStmt(Function &stmt) {
-    // Collect args types (for the moment, takes only one type)
-    std::vector<llvm::Type *> argTypes;
-    for (auto &param : stmt.params) { argTypes.push_back(builder.getPtrTy()); }
-
-    // Create function type (for the moment, returns only void)
-    llvm::FunctionType *funcType = llvm::FunctionType::get(builder.getVoidTy(), argTypes, false);
+    llvm::FunctionType *funcType = functionType(stmt);
 
-    // Create the function inside the module (by default, function is public)
+    // Internal: only main is called from outside the module, and every function left after dead code
+    // elimination is reached from it. This lets LLVM inline or drop functions without keeping a public copy.
+    // The exception is the top level of an interactive session, which later entries call into.
     llvm::Function *function =
-        llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, stmt.name.lexeme, module);
+        interactive && env->isTopLevel()
+            ? llvm::Function::Create(funcType, llvm::Function::ExternalLinkage,
+                                     globalName(stmt.name, stmt.slot), *module)
+            : llvm::Function::Create(funcType, llvm::Function::InternalLinkage, stmt.name.lexeme, *module);
 
-    env->declare(*this, stmt.name.lexeme, function);
+    env->bind(stmt.slot, function);
 
     // Name the function args
     unsigned idx = 0;
-    for (auto &arg : function->args()) { arg.setName(stmt.params[idx++].lexeme); }
+    for (auto &arg : function->args()) { arg.setName(stmt.params[idx++].name.lexeme); }
 
     // Save current insertion point
     llvm::BasicBlock *savedBB = builder.GetInsertBlock();
     llvm::Function *savedFn = savedBB ? savedBB->getParent() : nullptr;
 
     // Create entry block
-    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(context, "entry", function);
+    llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
     builder.SetInsertPoint(entryBB);
 
     // New env scope for locals
@@ -281,17 +350,22 @@ void CodeGenVisitor::visitFunctionStmt(Function &stmt) {
     env = std::make_unique<Environment>(previousEnv.get());
 
     // Allocate space on the stack for each param and store them
+    idx = 0;
     for (auto &arg : function->args()) {
-        llvm::AllocaInst *alloca = builder.CreateAlloca(arg.getType(), nullptr, arg.getName());
-        builder.CreateStore(&arg, alloca);
-        env->bind(arg.getName().str(), alloca);
+        Let &param = stmt.params[idx++];
+        env->declare(*this, param.slot, param.name.lexeme, arg.getType(), &arg);
     }
 
     // Emit body
     for (auto &bodyStmt : stmt.body) { bodyStmt->accept(*this); }
 
-    // If the body didn't return, insert default return
-    if (!builder.GetInsertBlock()->getTerminator()) { builder.CreateRetVoid(); }
+    // If the body didn't return, insert default return: nothing, or a zero of the result type
+    if (!builder.GetInsertBlock()->getTerminator()) {
+        if (funcType->getReturnType()->isVoidTy())
+            builder.CreateRetVoid();
+        else
+            builder.CreateRet(llvm::Constant::getNullValue(funcType->getReturnType()));
+    }
 
     // End scope for locals
     env = std::move(previousEnv);
@@ -306,14 +380,52 @@ void CodeGenVisitor::visitFunctionStmt(Function &stmt) {
 void CodeGenVisitor::visitClassStmt(Class &stmt) {
 }
 
+void CodeGenVisitor::visitReturnStmt(Return &stmt) {
+    if (stmt.value)
+        builder.CreateRet(stmt.value->accept(*this));
+    else
+        builder.CreateRetVoid();
+
+    // Code after a return is unreachable, but still needs a block to go into
+    llvm::Function *function = builder.GetInsertBlock()->getParent();
+    builder.SetInsertPoint(llvm::BasicBlock::Create(*context, "afterreturn", function));
+}
+
 // === Entry point: wraps expression in function main ===
-void CodeGenVisitor::generate(std::vector<UniqueStmt> &statements) {
+void CodeGenVisitor::generate(Program &program) {
     auto *funcType = llvm::FunctionType::get(builder.getInt32Ty(), false);
-    auto *function = llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, "main", module);
-    auto *entryBB = llvm::BasicBlock::Create(context, "entry", function);
+    auto *function = llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, "main", *module);
+    auto *entryBB = llvm::BasicBlock::Create(*context, "entry", function);
     builder.SetInsertPoint(entryBB);
 
-    for (auto &statement : statements) { statement->accept(*this); }
+    for (auto &statement : program.statements) { statement->accept(*this); }
+
+    // Always 0: `marbl run` reports its own failures with the other exit statuses
+    builder.CreateRet(llvm::ConstantInt::get(*context, llvm::APInt(32, 0)));
+}
+
+void CodeGenVisitor::generateEntry(Program &entry, const std::string &name,
+                                   const std::vector<Stmt *> &globals) {
+    interactive = true;
+
+    // The JIT links these declarations to the definitions in the modules of earlier entries
+    for (uint32_t slot = 0; slot < globals.size(); slot++) {
+        if (!globals[slot]) continue;
+        if (auto *let = globals[slot]->as<Let>()) {
+            env->bind(slot, new llvm::GlobalVariable(*module, typeOf(let->declaredType), false,
+                                                     llvm::GlobalValue::ExternalLinkage, nullptr,
+                                                     globalName(let->name, slot)));
+        } else if (auto *function = globals[slot]->as<Function>()) {
+            env->bind(slot, llvm::Function::Create(functionType(*function), llvm::Function::ExternalLinkage,
+                                                   globalName(function->name, slot), *module));
+        }
+    }
+
+    auto *function = llvm::Function::Create(llvm::FunctionType::get(builder.getVoidTy(), false),
+                                            llvm::Function::ExternalLinkage, name, *module);
+    builder.SetInsertPoint(llvm::BasicBlock::Create(*context, "entry", function));
+
+    for (auto &statement : entry.statements) { statement->accept(*this); }
 
-    builder.CreateRet(llvm::ConstantInt::get(context, llvm::APInt(32, 0)));
+    builder.CreateRetVoid();
 }
@@ -1,89 +1,115 @@
 #pragma once
 
 #include "ast.hpp"
+#include "program.hpp"
 
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 
-class CodeGenVisitor : public ExprVisitor<llvm::Value *>, StmtVisitor<void> {
+class CodeGenVisitor {
+    // Scopes mirror the Resolver's: a use finds its variable `depth` scopes out, at index `slot`
     class Environment {
-        std::unordered_map<std::string, llvm::Value *> variables;
+        std::vector<llvm::Value *> slots;
         Environment *enclosing;
 
       public:
-        Environment() : variables({}), enclosing{nullptr} {}
-        Environment(Environment *enclosing) : variables({}), enclosing(std::move(enclosing)) {}
+        Environment() : enclosing{nullptr} {}
+        Environment(Environment *enclosing) : enclosing(enclosing) {}
 
-        llvm::Value *get(std::string id) {
-            auto *value = variables[id];
-
-            if (!value && enclosing) return enclosing->get(id);
-            if (!value) throw std::runtime_error("Undefined variable: " + id);
-
-            return value;
+        llvm::Value *get(uint16_t depth, uint32_t slot) {
+            Environment *scope = this;
+            for (; depth > 0; depth--) scope = scope->enclosing;
+            return scope->slots[slot];
         }
 
-        void assign(CodeGenVisitor &codeGenVisitor, std::string id, llvm::Value *value) {
-            codeGenVisitor.builder.CreateStore(value, Environment::get(id));
+        void assign(CodeGenVisitor &codeGenVisitor, uint16_t depth, uint32_t slot, llvm::Value *value) {
+            codeGenVisitor.builder.CreateStore(value, get(depth, slot));
         }
 
-        void declare(CodeGenVisitor &codeGenVisitor, std::string id, llvm::Value *value) {
-            if (auto *fun = llvm::dyn_cast<llvm::Function>(value)) {
-                variables[id] = fun;
-                return;
-            }
-
-            // Allocate space on the stack for the variable
-            llvm::AllocaInst *alloca = codeGenVisitor.builder.CreateAlloca(value->getType(), nullptr, id);
+        // Allocates the variable in the entry block of the current function, where mem2reg can promote it
+        void declare(CodeGenVisitor &codeGenVisitor, uint32_t slot, std::string_view name, llvm::Type *type,
+                     llvm::Value *value) {
+            llvm::Function *function = codeGenVisitor.builder.GetInsertBlock()->getParent();
+            llvm::IRBuilder<> entry(&function->getEntryBlock(), function->getEntryBlock().begin());
+            llvm::AllocaInst *alloca = entry.CreateAlloca(type, nullptr, name);
             codeGenVisitor.builder.CreateStore(value, alloca);
-            variables[id] = alloca;
+            bind(slot, alloca);
         }
 
-        void bind(std::string id, llvm::Value *value) { variables[id] = value; }
+        void bind(uint32_t slot, llvm::Value *value) {
+            if (slot >= slots.size()) slots.resize(slot + 1);
+            slots[slot] = value;
+        }
+
+        bool isTopLevel() const { return !enclosing; }
     };
 
     std::unique_ptr<Environment> env;
 
-    llvm::LLVMContext context;
-    llvm::Module module;
+    // Owned through pointers so that takeModule can hand them over
+    std::unique_ptr<llvm::LLVMContext> context;
+    std::unique_ptr<llvm::Module> module;
     llvm::IRBuilder<> builder;
 
+    // One global per distinct string, however many literals or print statements use it
+    std::unordered_map<std::string_view, llvm::Constant *> strings;
+    llvm::Constant *stringConstant(std::string_view text);
+    // Whether two strings, which are NUL-terminated, hold the same text
+    llvm::Value *stringsEqual(llvm::Value *left, llvm::Value *right);
+
+    // Compiling an entry of an interactive session, whose top-level declarations outlive its module
+    bool interactive = false;
+    llvm::FunctionType *functionType(Function &stmt);
+
   public:
     CodeGenVisitor(const std::string &moduleName)
-        : env(std::make_unique<Environment>()), module(moduleName, context), builder(context) {
+        : env(std::make_unique<Environment>()), context(std::make_unique<llvm::LLVMContext>()),
+          module(std::make_unique<llvm::Module>(moduleName, *context)), builder(*context) {
 
         auto *clockFn = llvm::Function::Create(llvm::FunctionType::get(builder.getInt32Ty(), false),
-                                               llvm::Function::ExternalLinkage, "clock", module);
-        env->declare(*this, "clock", clockFn);
+                                               llvm::Function::ExternalLinkage, "clock", *module);
+        env->bind(0, clockFn); // The slots the Resolver gives the builtins
 
         auto *printfFn = llvm::Function::Create(
             llvm::FunctionType::get(builder.getInt32Ty(), llvm::PointerType::get(builder.getInt8Ty(), 0),
                                     true),
-            llvm::Function::ExternalLinkage, "printf", module);
-        env->declare(*this, "printf", printfFn);
+            llvm::Function::ExternalLinkage, "printf", *module);
+        env->bind(1, printfFn);
     }
 
     llvm::Value *convertToi1(llvm::Value *value);
-    llvm::Module &getModule() { return module; }
-
-    void generate(std::vector<UniqueStmt> &statements);
-
-    llvm::Value *visitLiteralExpr(Literal &expr) override;
-    llvm::Value *visitBinaryExpr(Binary &expr) override;
-    llvm::Value *visitLogicalExpr(Logical &expr) override;
-    llvm::Value *visitUnaryExpr(Unary &expr) override;
-    llvm::Value *visitGroupingExpr(Grouping &expr) override;
-    llvm::Value *visitVariableExpr(Variable &expr) override;
-    llvm::Value *visitAssignExpr(Assign &expr) override;
-    llvm::Value *visitCallExpr(Call &expr) override;
-
-    void visitExpressionStmt(Expression &stmt) override;
-    void visitPrintStmt(Print &stmt) override;
-    void visitIfStmt(If &stmt) override;
-    void visitWhileStmt(While &stmt) override;
-    void visitLetStmt(Let &stmt) override;
-    void visitBlockStmt(Block &stmt) override;
-    void visitFunctionStmt(Function &stmt) override;
-    void visitClassStmt(Class &stmt) override;
+    // The machine type of a value the type checker typed
+    llvm::Type *typeOf(Type type);
+    llvm::Module &getModule() { return *module; }
+    // Gives the module, with the context it lives in, to a JIT. The visitor cannot be used afterwards.
+    llvm::orc::ThreadSafeModule takeModule() { return {std::move(module), std::move(context)}; }
+
+    void generate(Program &program);
+    // Compiles one entry of an interactive session into a function `name` that takes and returns nothing.
+    // Top-level lets become global variables and top-level functions get external linkage, both named after
+    // their slot, so that the modules of later entries can use them. `globals` holds the top-level Let and
+    // Function nodes of the earlier entries by slot, nullptr elsewhere; they are declared in this module.
+    void generateEntry(Program &entry, const std::string &name, const std::vector<Stmt *> &globals);
+
+    llvm::Value *visitLiteralExpr(Literal &expr);
+    llvm::Value *visitBinaryExpr(Binary &expr);
+    llvm::Value *visitLogicalExpr(Logical &expr);
+    llvm::Value *visitUnaryExpr(Unary &expr);
+    llvm::Value *visitGroupingExpr(Grouping &expr);
+    llvm::Value *visitVariableExpr(Variable &expr);
+    llvm::Value *visitAssignExpr(Assign &expr);
+    llvm::Value *visitCallExpr(Call &expr);
+    llvm::Value *visitTypeAnnotationExpr(TypeAnnotation &expr);
+
+    void visitExpressionStmt(Expression &stmt);
+    void visitPrintStmt(Print &stmt);
+    void visitIfStmt(If &stmt);
+    void visitWhileStmt(While &stmt);
+    void visitLetStmt(Let &stmt);
+    void visitBlockStmt(Block &stmt);
+    void visitFunctionStmt(Function &stmt);
+    void visitClassStmt(Class &stmt);
+    void visitReturnStmt(Return &stmt);
 };
@@ -1,38 +1,27 @@
 #include "marbl.hpp"
 
-#include <sstream>
-#include <vector>
+#include <string>
 
-#include "lexer.hpp"
-#include "parser.hpp"
-#include "printer.hpp"
-#include "tokens.hpp"
+#include "repl.hpp"
 
-int Marbl::runFile(char *filepath) {
-    std::ifstream inputFile(filepath);
-
-    if (!inputFile) {
-        std::cerr << "Cannot open input file!" << std::endl;
-        return EX_NOINPUT;
-    }
-
-    Parser parser{inputFile, std::string(filepath)};
-    std::vector<UniqueStmt> statements = parser.parse();
-
-    for (auto &statement : statements) {
-        AstPrinter printer{};
-        printer.print(*statement);
+int Marbl::runPrompt() {
+    llvm::Expected<Repl> repl = Repl::create();
+    if (!repl) {
+        std::cerr << "Cannot start the JIT: " << llvm::toString(repl.takeError()) << std::endl;
+        return EX_SOFTWARE;
     }
 
-    inputFile.close();
-
-    if (hadError) EX_DATAERR;
-
-    return EX_OK;
-}
-
-int Marbl::runPrompt() {
+    // An entry goes on over the next lines while it stops in the middle of a declaration, e.g. of a function,
+    // and an empty line ends it regardless, which shows what is wrong with it
+    std::string entry;
     std::string line;
+    while (std::cout << (entry.empty() ? "> " : ". ") << std::flush && std::getline(std::cin, line)) {
+        if (entry.empty() && line.empty()) continue;
+        entry += line;
+        entry += '\n';
+        if (repl->evaluate(entry, line.empty()) != Repl::Outcome::Incomplete) entry.clear();
+    }
+    if (!entry.empty()) repl->evaluate(entry, true);
     std::cout << std::endl;
 
     return hadError ? EX_DATAERR : EX_OK;
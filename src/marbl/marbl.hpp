@@ -1,6 +1,5 @@
 #pragma once
 
-#include <fstream>
 #include <iostream>
 #include <string>
 
@@ -16,6 +15,5 @@ class Marbl {
   public:
     inline static bool hadError = false;
 
-    static int runFile(char *filepath);
     static int runPrompt();
 };
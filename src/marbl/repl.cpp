@@ -0,0 +1,119 @@
+#include "repl.hpp"
+
+#include <cstdio>
+#include <iostream>
+
+#include "constant_folder.hpp"
+#include "errors.hpp"
+#include "llvm_codegen.hpp"
+#include "parser.hpp"
+#include "source.hpp"
+
+#include "llvm/ADT/ScopeExit.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace {
+Repl::Outcome report(const std::vector<Diagnostic> &diagnostics) {
+    Errors::print(std::cerr, diagnostics);
+    return Repl::Outcome::Rejected;
+}
+
+Repl::Outcome report(llvm::Error error) {
+    llvm::errs() << "error: " << llvm::toString(std::move(error)) << "\n";
+    return Repl::Outcome::Rejected;
+}
+
+// Whether more text could still complete what was parsed: a syntax error at the end of the text, or a quote
+// that starts a string without an end
+bool isCutOff(const Parser &parser) {
+    const TokenStream &tokens = parser.getTokens();
+    size_t end = tokens.size() - 1; // The T_EOF token
+    for (const Diagnostic &diagnostic : parser.getDiagnostics()) {
+        if (diagnostic.line == tokens.line(end) && diagnostic.col == tokens.col(end)) return true;
+    }
+    for (size_t i = 0; i < end; i++) {
+        if (tokens.type(i) == ERROR && tokens.getText()[tokens.offset(i)] == '"') return true;
+    }
+    return false;
+}
+} // namespace
+
+llvm::Expected<Repl> Repl::create() {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    llvm::InitializeNativeTargetAsmParser();
+
+    llvm::Expected<std::unique_ptr<llvm::orc::LLLazyJIT>> jit = llvm::orc::LLLazyJITBuilder().create();
+    if (!jit) return jit.takeError();
+
+    auto host = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        (*jit)->getDataLayout().getGlobalPrefix());
+    if (!host) return host.takeError();
+    (*jit)->getMainJITDylib().addGenerator(std::move(*host));
+
+    return Repl(std::move(*jit));
+}
+
+Repl::Outcome Repl::evaluate(std::string text, bool last) {
+    // Only the entries that ran are referred to later, so a session keeps no text it rejected
+    FileId source = Sources::add("repl", std::move(text));
+    bool accepted = false;
+    auto release = llvm::make_scope_exit([&] {
+        if (!accepted) Sources::release(source);
+    });
+
+    Parser parser{source};
+    Program entry = parser.parse();
+    if (parser.hadError() && !last && isCutOff(parser)) return Outcome::Incomplete;
+    if (parser.hadError()) return report(parser.getDiagnostics());
+
+    // The passes run on copies, which only replace the session's once the entry is in the JIT and found there
+    Resolver resolved = resolver;
+    resolved.resolveEntry(entry);
+    if (resolved.hadError()) return report(resolved.getDiagnostics());
+
+    TypeChecker checked = checker;
+    checked.checkEntry(entry);
+    if (checked.hadError()) return report(checked.getDiagnostics());
+
+    // No dead code elimination: a function no entry calls yet may be called by the next one
+    ConstantFolder folder(true);
+    folder.fold(entry);
+
+    std::string name = "entry." + std::to_string(entries.size());
+    CodeGenVisitor codegen(name);
+    try {
+        codegen.generateEntry(entry, name, globals);
+    } catch (const std::runtime_error &error) {
+        std::cerr << "error: " << error.what() << "\n";
+        return Outcome::Rejected;
+    }
+    codegen.getModule().setDataLayout(jit->getDataLayout());
+    codegen.getModule().setTargetTriple(jit->getTargetTriple().str());
+
+    // What addLazyIRModule does, with a tracker: until the lookup succeeds, the entry can still be taken back
+    // out of the JIT along with its symbols
+    llvm::orc::ResourceTrackerSP tracker = jit->getMainJITDylib().createResourceTracker();
+    if (llvm::Error error = jit->getCompileOnDemandLayer().add(tracker, codegen.takeModule())) {
+        return report(std::move(error));
+    }
+    llvm::Expected<llvm::orc::ExecutorAddr> run = jit->lookup(name);
+    if (!run) return report(llvm::joinErrors(run.takeError(), tracker->remove()));
+
+    accepted = true;
+    resolver = std::move(resolved);
+    resolver.acceptEntry();
+    checker = std::move(checked);
+    for (StmtPtr statement : entry.statements) {
+        if (statement->kind != NodeKind::Let && statement->kind != NodeKind::Function) continue;
+        if (statement->slot >= globals.size()) globals.resize(statement->slot + 1);
+        globals[statement->slot] = statement;
+    }
+    entries.push_back(std::move(entry));
+
+    run->toPtr<void (*)()>()();
+    std::fflush(stdout);
+    return Outcome::Ran;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "program.hpp"
+#include "resolver.hpp"
+#include "type_checker.hpp"
+
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+
+// An interactive session. Each entry is parsed, resolved and checked against the top-level declarations of
+// the entries before it, then compiled to a module of its own and added to a lazy ORC JIT, which compiles a
+// function the first time it is called rather than when its entry is added. Top-level lets become globals,
+// so they and top-level functions can be used by every later entry without being compiled again.
+//
+// An entry that does not compile leaves the session as it was.
+class Repl {
+  public:
+    enum class Outcome { Ran, Rejected, Incomplete };
+
+    // Sets up a JIT for the host, in which printf and clock are those of this process
+    static llvm::Expected<Repl> create();
+
+    // Compiles and runs one entry, reporting its errors on stderr. An entry that stops in the middle of a
+    // declaration (in a function body, or inside a string) is Incomplete instead, so that the caller can
+    // append the next line to it, unless `last` says that no more text will come.
+    Outcome evaluate(std::string text, bool last);
+
+  private:
+    explicit Repl(std::unique_ptr<llvm::orc::LLLazyJIT> jit) : jit(std::move(jit)) {}
+
+    std::unique_ptr<llvm::orc::LLLazyJIT> jit;
+    Resolver resolver;
+    TypeChecker checker;
+    // The entries that ran. Their nodes must live as long as the session: the resolver refers to them, and
+    // the modules of later entries are generated from their declarations.
+    std::vector<Program> entries;
+    std::vector<Stmt *> globals; // The top-level Let and Function nodes, by slot
+};
@@ -0,0 +1,237 @@
+#include "constant_folder.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+
+namespace {
+// The value of an expression that is a literal. An integer literal the type checker made a float reads as a
+// double, which is how codegen emits it.
+std::optional<Object> valueOf(ExprPtr expr) {
+    auto *literal = expr->as<Literal>();
+    if (!literal) return std::nullopt;
+    if (auto *value = std::get_if<int>(&literal->value); value && expr->type == Type::Float) {
+        return static_cast<double>(*value);
+    }
+    return literal->value;
+}
+
+// What a condition or a logical operand converts to, as in CodeGenVisitor::convertToi1
+std::optional<bool> truthy(const Object &value) {
+    if (auto *i = std::get_if<int>(&value)) return *i != 0;
+    if (auto *d = std::get_if<double>(&value)) return *d < 0 || *d > 0; // Ordered: NaN is false
+    if (auto *b = std::get_if<bool>(&value)) return *b;
+    return std::nullopt;
+}
+
+template <typename T> std::optional<Object> compare(TokenType op, T a, T b) {
+    switch (op) {
+    case TokenType::LESS: return a < b;
+    case TokenType::LESS_EQUAL: return a <= b;
+    case TokenType::GREATER: return a > b;
+    case TokenType::GREATER_EQUAL: return a >= b;
+    case TokenType::EQUAL_EQUAL: return a == b;
+    case TokenType::BANG_EQUAL:
+        if constexpr (std::is_same_v<T, double>) return a < b || a > b; // Ordered, like fcmp one
+        return a != b;
+    default: return std::nullopt;
+    }
+}
+
+std::optional<Object> binary(TokenType op, const Object &left, const Object &right) {
+    if (auto *a = std::get_if<int>(&left), *b = std::get_if<int>(&right); a && b) {
+        // Unsigned, so that overflow wraps around like the 32-bit LLVM instructions
+        uint32_t x = *a, y = *b;
+        switch (op) {
+        case TokenType::PLUS: return static_cast<int>(x + y);
+        case TokenType::MINUS: return static_cast<int>(x - y);
+        case TokenType::STAR: return static_cast<int>(x * y);
+        case TokenType::SLASH:
+            if (*b == 0 || (*a == INT_MIN && *b == -1)) return std::nullopt; // Undefined: left to run time
+            return *a / *b;
+        default: return compare(op, *a, *b);
+        }
+    }
+    if (auto *a = std::get_if<double>(&left), *b = std::get_if<double>(&right); a && b) {
+        switch (op) {
+        case TokenType::PLUS: return *a + *b;
+        case TokenType::MINUS: return *a - *b;
+        case TokenType::STAR: return *a * *b;
+        case TokenType::SLASH: return *a / *b;
+        default: return compare(op, *a, *b);
+        }
+    }
+    if (auto *a = std::get_if<bool>(&left), *b = std::get_if<bool>(&right); a && b) {
+        return compare(op, *a, *b);
+    }
+    // Interned, so the same text is the same symbol
+    if (auto *a = std::get_if<StringLiteral>(&left), *b = std::get_if<StringLiteral>(&right); a && b) {
+        if (op == TokenType::EQUAL_EQUAL) return a->id == b->id;
+        if (op == TokenType::BANG_EQUAL) return a->id != b->id;
+    }
+    return std::nullopt;
+}
+
+// Whether dropping the statement would lose a declaration of the scope around it
+bool declares(StmtPtr stmt) {
+    return stmt && (stmt->kind == NodeKind::Let || stmt->kind == NodeKind::Function);
+}
+} // namespace
+
+void ConstantFolder::fold(Program &program) {
+    arena = program.arena.get();
+    scopes.emplace_back();
+    foldAll(program.statements);
+    scopes.pop_back();
+}
+
+template <typename List> void ConstantFolder::foldAll(List &statements) {
+    for (StmtPtr &statement : statements) statement = fold(statement);
+    std::erase(statements, nullptr);
+}
+
+StmtPtr ConstantFolder::orEmpty(StmtPtr stmt) {
+    return stmt ? stmt : arena->make<Block>(AstList<StmtPtr>(arena->getResource()));
+}
+
+ExprPtr ConstantFolder::literal(const Token &token, Object value, Type type) {
+    Literal *literal = arena->make<Literal>(token, std::move(value));
+    literal->type = type;
+    return literal;
+}
+
+// ======= Expressions =======
+
+ExprPtr ConstantFolder::visitBinaryExpr(Binary &expr) {
+    expr.left = fold(expr.left);
+    expr.right = fold(expr.right);
+
+    std::optional<Object> left = valueOf(expr.left);
+    std::optional<Object> right = valueOf(expr.right);
+    if (!left || !right) return &expr;
+
+    std::optional<Object> value = binary(expr.op.tokenType, *left, *right);
+    return value ? literal(expr.op, std::move(*value), expr.type) : &expr;
+}
+
+ExprPtr ConstantFolder::visitLogicalExpr(Logical &expr) {
+    expr.left = fold(expr.left);
+    expr.right = fold(expr.right);
+
+    // Codegen evaluates both operands, so only two constants fold
+    std::optional<Object> left = valueOf(expr.left);
+    std::optional<Object> right = valueOf(expr.right);
+    std::optional<bool> a = left ? truthy(*left) : std::nullopt;
+    std::optional<bool> b = right ? truthy(*right) : std::nullopt;
+    if (!a || !b) return &expr;
+
+    bool value = expr.op.tokenType == TokenType::AND ? *a && *b : *a || *b;
+    return literal(expr.op, value, expr.type);
+}
+
+ExprPtr ConstantFolder::visitUnaryExpr(Unary &expr) {
+    expr.right = fold(expr.right);
+
+    std::optional<Object> right = valueOf(expr.right);
+    if (!right) return &expr;
+
+    if (expr.op.tokenType == TokenType::BANG) {
+        std::optional<bool> value = truthy(*right);
+        return value ? literal(expr.op, !*value, expr.type) : &expr;
+    }
+    if (auto *i = std::get_if<int>(&*right)) return literal(expr.op, static_cast<int>(0u - *i), expr.type);
+    if (auto *d = std::get_if<double>(&*right)) return literal(expr.op, -*d, expr.type);
+    return &expr;
+}
+
+ExprPtr ConstantFolder::visitGroupingExpr(Grouping &expr) {
+    expr.expression = fold(expr.expression);
+    return expr.expression->kind == NodeKind::Literal ? expr.expression : &expr;
+}
+
+ExprPtr ConstantFolder::visitVariableExpr(Variable &expr) {
+    const std::vector<std::optional<Object>> &scope = scopes[scopes.size() - 1 - expr.depth];
+    if (expr.slot < scope.size() && scope[expr.slot]) return literal(expr.name, *scope[expr.slot], expr.type);
+    return &expr;
+}
+
+ExprPtr ConstantFolder::visitAssignExpr(Assign &expr) {
+    expr.value = fold(expr.value);
+    return &expr;
+}
+
+ExprPtr ConstantFolder::visitCallExpr(Call &expr) {
+    for (ExprPtr &arg : expr.arguments) arg = fold(arg);
+    return &expr;
+}
+
+// ======= Statements =======
+
+StmtPtr ConstantFolder::visitExpressionStmt(Expression &stmt) {
+    stmt.expression = fold(stmt.expression);
+    return stmt.expression->kind == NodeKind::Literal ? nullptr : &stmt;
+}
+
+StmtPtr ConstantFolder::visitPrintStmt(Print &stmt) {
+    stmt.expression = fold(stmt.expression);
+    return &stmt;
+}
+
+StmtPtr ConstantFolder::visitIfStmt(If &stmt) {
+    stmt.condition = fold(stmt.condition);
+    stmt.thenBranch = fold(stmt.thenBranch);
+    stmt.elseBranch = fold(stmt.elseBranch);
+
+    std::optional<Object> condition = valueOf(stmt.condition);
+    std::optional<bool> taken = condition ? truthy(*condition) : std::nullopt;
+    if (taken && !declares(*taken ? stmt.elseBranch : stmt.thenBranch)) {
+        return *taken ? stmt.thenBranch : stmt.elseBranch;
+    }
+
+    stmt.thenBranch = orEmpty(stmt.thenBranch);
+    return &stmt;
+}
+
+StmtPtr ConstantFolder::visitWhileStmt(While &stmt) {
+    stmt.condition = fold(stmt.condition);
+    stmt.body = fold(stmt.body);
+
+    std::optional<Object> condition = valueOf(stmt.condition);
+    if (condition && truthy(*condition) == false && !declares(stmt.body)) return nullptr;
+
+    stmt.body = orEmpty(stmt.body);
+    return &stmt;
+}
+
+StmtPtr ConstantFolder::visitLetStmt(Let &stmt) {
+    stmt.initializer = fold(stmt.initializer);
+    if (stmt.reassigned || !stmt.initializer || (keepTopLevelLets && scopes.size() == 1)) return &stmt;
+
+    std::optional<Object> value = valueOf(stmt.initializer);
+    if (!value) return &stmt;
+
+    // Every use becomes a literal, so the variable itself is no longer needed
+    std::vector<std::optional<Object>> &scope = scopes.back();
+    if (stmt.slot >= scope.size()) scope.resize(stmt.slot + 1);
+    scope[stmt.slot] = std::move(value);
+    return nullptr;
+}
+
+StmtPtr ConstantFolder::visitBlockStmt(Block &stmt) {
+    scopes.emplace_back();
+    foldAll(stmt.statements);
+    scopes.pop_back();
+    return stmt.statements.empty() ? nullptr : &stmt;
+}
+
+StmtPtr ConstantFolder::visitFunctionStmt(Function &stmt) {
+    scopes.emplace_back();
+    foldAll(stmt.body);
+    scopes.pop_back();
+    return &stmt;
+}
+
+StmtPtr ConstantFolder::visitReturnStmt(Return &stmt) {
+    stmt.value = fold(stmt.value);
+    return &stmt;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <optional>
+#include <vector>
+
+#include "ast.hpp"
+#include "program.hpp"
+
+// Simplifies a resolved and type-checked program before codegen, so that less IR reaches LLVM, which does
+// little cleanup at -O0 or when JIT compiling:
+// - operators whose operands are all literals are evaluated, with the semantics codegen gives them (32-bit
+//   wrapping ints, IEEE doubles, ordered float comparisons); integer division by zero is left to run time;
+// - a let with a constant initializer that is never reassigned is dropped, and its uses become literals;
+// - an if or a while with a constant condition keeps only the branch that runs, and expression statements
+//   left with no effect are removed.
+// New nodes are allocated in the program's arena and get the type of the node they replace.
+class ConstantFolder {
+  public:
+    // In an interactive session, a later entry can still assign to a top-level let, so those must be kept
+    explicit ConstantFolder(bool keepTopLevelLets = false) : keepTopLevelLets(keepTopLevelLets) {}
+
+    void fold(Program &program);
+
+    // Each visit returns the node to use instead of the one visited: the same one, a literal, or for a
+    // statement nullptr when it can be dropped
+    ExprPtr visitLiteralExpr(Literal &expr) { return &expr; }
+    ExprPtr visitBinaryExpr(Binary &expr);
+    ExprPtr visitLogicalExpr(Logical &expr);
+    ExprPtr visitUnaryExpr(Unary &expr);
+    ExprPtr visitGroupingExpr(Grouping &expr);
+    ExprPtr visitVariableExpr(Variable &expr);
+    ExprPtr visitAssignExpr(Assign &expr);
+    ExprPtr visitCallExpr(Call &expr);
+    ExprPtr visitTypeAnnotationExpr(TypeAnnotation &expr) { return &expr; }
+
+    StmtPtr visitExpressionStmt(Expression &stmt);
+    StmtPtr visitPrintStmt(Print &stmt);
+    StmtPtr visitIfStmt(If &stmt);
+    StmtPtr visitWhileStmt(While &stmt);
+    StmtPtr visitLetStmt(Let &stmt);
+    StmtPtr visitBlockStmt(Block &stmt);
+    StmtPtr visitFunctionStmt(Function &stmt);
+    StmtPtr visitClassStmt(Class &stmt) { return &stmt; }
+    StmtPtr visitReturnStmt(Return &stmt);
+
+  private:
+    AstArena *arena = nullptr;
+    bool keepTopLevelLets;
+    // The value of each propagated let, by the resolver's scopes and slots
+    std::vector<std::vector<std::optional<Object>>> scopes;
+
+    ExprPtr fold(ExprPtr expr) { return expr ? expr->accept(*this) : nullptr; }
+    StmtPtr fold(StmtPtr stmt) { return stmt ? stmt->accept(*this) : nullptr; }
+    template <typename List> void foldAll(List &statements);
+    // A statement that can stand where one is required, e.g. as the body of a while
+    StmtPtr orEmpty(StmtPtr stmt);
+    ExprPtr literal(const Token &token, Object value, Type type);
+};
@@ -0,0 +1,118 @@
+#include "dead_code_eliminator.hpp"
+
+#include <algorithm>
+#include <utility>
+
+void DeadCodeEliminator::eliminate(Program &program) {
+    // Build the call graph
+    scopes.emplace_back();
+    for (StmtPtr statement : program.statements) statement->accept(*this);
+    scopes.pop_back();
+
+    // Everything top-level code reaches is live
+    std::vector<const Function *> worklist{nullptr};
+    while (!worklist.empty()) {
+        auto it = calls.find(worklist.back());
+        worklist.pop_back();
+        if (it == calls.end()) continue;
+
+        for (Function *callee : it->second) {
+            if (live.insert(callee).second) worklist.push_back(callee);
+        }
+    }
+
+    sweep(program.statements);
+}
+
+template <typename List> void DeadCodeEliminator::sweep(List &statements) {
+    std::erase_if(statements, [&](StmtPtr stmt) {
+        if (stmt->kind == NodeKind::Class) return true;
+        if (auto *function = stmt->as<Function>(); function && !live.contains(function)) return true;
+        sweep(stmt);
+        return false;
+    });
+}
+
+// Functions can be declared in nested blocks, so the sweep looks into every statement that holds others
+void DeadCodeEliminator::sweep(StmtPtr stmt) {
+    if (!stmt) return;
+    if (auto *block = stmt->as<Block>()) sweep(block->statements);
+    if (auto *function = stmt->as<Function>()) sweep(function->body);
+    if (auto *ifStmt = stmt->as<If>()) {
+        sweep(ifStmt->thenBranch);
+        sweep(ifStmt->elseBranch);
+    }
+    if (auto *whileStmt = stmt->as<While>()) sweep(whileStmt->body);
+}
+
+// ======= Expressions =======
+
+void DeadCodeEliminator::visitBinaryExpr(Binary &expr) {
+    expr.left->accept(*this);
+    expr.right->accept(*this);
+}
+
+void DeadCodeEliminator::visitLogicalExpr(Logical &expr) {
+    expr.left->accept(*this);
+    expr.right->accept(*this);
+}
+
+void DeadCodeEliminator::visitUnaryExpr(Unary &expr) { expr.right->accept(*this); }
+
+void DeadCodeEliminator::visitGroupingExpr(Grouping &expr) { expr.expression->accept(*this); }
+
+// Functions are only ever named to be called, so every use of one is an edge of the call graph
+void DeadCodeEliminator::visitVariableExpr(Variable &expr) {
+    const std::vector<Function *> &scope = scopes[scopes.size() - 1 - expr.depth];
+    if (expr.slot < scope.size() && scope[expr.slot]) calls[current].push_back(scope[expr.slot]);
+}
+
+void DeadCodeEliminator::visitAssignExpr(Assign &expr) { expr.value->accept(*this); }
+
+void DeadCodeEliminator::visitCallExpr(Call &expr) {
+    expr.callee->accept(*this);
+    for (ExprPtr arg : expr.arguments) arg->accept(*this);
+}
+
+// ======= Statements =======
+
+void DeadCodeEliminator::visitExpressionStmt(Expression &stmt) { stmt.expression->accept(*this); }
+
+void DeadCodeEliminator::visitPrintStmt(Print &stmt) { stmt.expression->accept(*this); }
+
+void DeadCodeEliminator::visitIfStmt(If &stmt) {
+    stmt.condition->accept(*this);
+    stmt.thenBranch->accept(*this);
+    if (stmt.elseBranch) stmt.elseBranch->accept(*this);
+}
+
+void DeadCodeEliminator::visitWhileStmt(While &stmt) {
+    stmt.condition->accept(*this);
+    stmt.body->accept(*this);
+}
+
+void DeadCodeEliminator::visitLetStmt(Let &stmt) {
+    if (stmt.initializer) stmt.initializer->accept(*this);
+}
+
+void DeadCodeEliminator::visitBlockStmt(Block &stmt) {
+    scopes.emplace_back();
+    for (StmtPtr statement : stmt.statements) statement->accept(*this);
+    scopes.pop_back();
+}
+
+void DeadCodeEliminator::visitFunctionStmt(Function &stmt) {
+    std::vector<Function *> &scope = scopes.back();
+    if (stmt.slot >= scope.size()) scope.resize(stmt.slot + 1);
+    scope[stmt.slot] = &stmt;
+
+    Function *caller = std::exchange(current, &stmt);
+    scopes.emplace_back();
+    for (StmtPtr statement : stmt.body) statement->accept(*this);
+    scopes.pop_back();
+    current = caller;
+}
+
+void DeadCodeEliminator::visitReturnStmt(Return &stmt) {
+    if (stmt.value) stmt.value->accept(*this);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ast.hpp"
+#include "program.hpp"
+
+// Removes the functions that cannot be called, so that codegen, LLVM's passes and the object file only pay
+// for the code a program uses. Top-level code, which becomes main, is the root of the call graph; every
+// function it does not reach through calls is dropped, wherever it is declared. Classes are dropped too:
+// nothing can refer to one yet, and codegen emits nothing for them.
+//
+// Runs on a resolved program, after the ConstantFolder, so that calls in pruned branches do not keep their
+// callees alive.
+class DeadCodeEliminator {
+  public:
+    void eliminate(Program &program);
+
+    void visitLiteralExpr(Literal &) {}
+    void visitBinaryExpr(Binary &expr);
+    void visitLogicalExpr(Logical &expr);
+    void visitUnaryExpr(Unary &expr);
+    void visitGroupingExpr(Grouping &expr);
+    void visitVariableExpr(Variable &expr);
+    void visitAssignExpr(Assign &expr);
+    void visitCallExpr(Call &expr);
+    void visitTypeAnnotationExpr(TypeAnnotation &) {}
+
+    void visitExpressionStmt(Expression &stmt);
+    void visitPrintStmt(Print &stmt);
+    void visitIfStmt(If &stmt);
+    void visitWhileStmt(While &stmt);
+    void visitLetStmt(Let &stmt);
+    void visitBlockStmt(Block &stmt);
+    void visitFunctionStmt(Function &stmt);
+    void visitClassStmt(Class &) {}
+    void visitReturnStmt(Return &stmt);
+
+  private:
+    // The function each slot of the resolver's scopes holds, nullptr for variables and builtins
+    std::vector<std::vector<Function *>> scopes;
+    Function *current = nullptr; // Whose body is being visited; nullptr for top-level code
+    // The functions each function calls; top-level code is under nullptr
+    std::unordered_map<const Function *, std::vector<Function *>> calls;
+    std::unordered_set<const Function *> live;
+
+    template <typename List> void sweep(List &statements);
+    void sweep(StmtPtr stmt);
+};
@@ -0,0 +1,259 @@
+#include "incremental.hpp"
+
+#include <algorithm>
+
+#include "parser.hpp"
+
+namespace {
+// Moves the tokens of an already parsed subtree to where they are after an edit
+class Relocator {
+  public:
+    Relocator(int lineShift, int64_t indexShift) : lineShift(lineShift), indexShift(indexShift) {}
+
+    // Also points the lexemes, lexed from `from`, into `to` moved by `textShift` bytes
+    void rebase(const SourceFile &from, const SourceFile &to, FileId toId, int64_t shift) {
+        fromText = from.getText().data();
+        toText = to.getText().data();
+        toFile = toId;
+        textShift = shift;
+    }
+
+    void relocate(Stmt &stmt) { stmt.accept(*this); }
+
+  private:
+    friend class ::Expr;
+    friend class ::Stmt;
+
+    int lineShift;
+    int64_t indexShift;
+    const char *fromText = nullptr;
+    const char *toText = nullptr;
+    FileId toFile = 0;
+    int64_t textShift = 0;
+
+    void shift(ExprPtr expr) {
+        if (expr) expr->accept(*this);
+    }
+    void shift(StmtPtr stmt) {
+        if (stmt) stmt->accept(*this);
+    }
+    void shift(Let &let) { shift(static_cast<StmtPtr>(&let)); }
+    void shift(Function &function) { shift(static_cast<StmtPtr>(&function)); }
+    void shift(Token &token) {
+        token.line += lineShift;
+        token.index = static_cast<uint32_t>(token.index + indexShift);
+        if (fromText) {
+            token.lexeme = {toText + (token.lexeme.data() - fromText + textShift), token.lexeme.size()};
+            token.fileId = toFile;
+        }
+    }
+    void shift(Object &) {}
+    template <typename T> void shift(AstList<T> &list) {
+        for (auto &item : list) shift(item);
+    }
+
+#define RELOCATE_FIELD(type, name) shift(node.name);
+#define VISIT_RELOCATE(name, FIELDS, basename)                                                               \
+    void visit##name##basename(name &node) { FIELDS(RELOCATE_FIELD, RELOCATE_FIELD) }
+    EXPR_AST_NODES(VISIT_RELOCATE)
+    STMT_AST_NODES(VISIT_RELOCATE)
+#undef VISIT_RELOCATE
+#undef RELOCATE_FIELD
+};
+} // namespace
+
+IncrementalParser::IncrementalParser(FileId fileId) : name(Sources::get(fileId).getName()), fileId(fileId) {
+    parseAll();
+}
+
+IncrementalParser::~IncrementalParser() {
+    for (FileId version : versions) Sources::release(version);
+}
+
+void IncrementalParser::parseAll() {
+    program = Program();
+    declarations.clear();
+
+    Parser parser{fileId};
+    while (!parser.isAtEnd()) {
+        uint32_t first = static_cast<uint32_t>(parser.peekIndex());
+        size_t errors = parser.getDiagnostics().size();
+        StmtPtr stmt = parser.parseDeclaration(*program.arena);
+
+        uint32_t end = static_cast<uint32_t>(parser.peekIndex());
+        declarations.push_back({first, end, stmt, fileId, 0,
+                                {parser.getDiagnostics().begin() + errors, parser.getDiagnostics().end()},
+                                isOpenEnded(parser.getTokens(), first, end)});
+    }
+
+    tokens = parser.shareTokens();
+    program.tokens = tokens;
+    rebuildStatements();
+    reparsed = declarations.size();
+    reparsedSinceFull = 0;
+    releaseUnused();
+}
+
+bool IncrementalParser::apply(const TextEdit &edit) {
+    std::string_view text = getText();
+    if (edit.begin > edit.end || edit.end > text.size()) return false;
+
+    std::string updated;
+    updated.reserve(text.size() - (edit.end - edit.begin) + edit.text.size());
+    updated.append(text.substr(0, edit.begin)).append(edit.text).append(text.substr(edit.end));
+    FileId next = Sources::add(name, std::move(updated));
+    versions.push_back(next);
+    fileId = next;
+
+    if (reparsedSinceFull > declarations.size()) {
+        parseAll();
+        return true;
+    }
+
+    int64_t shift = static_cast<int64_t>(edit.text.size()) - static_cast<int64_t>(edit.end - edit.begin);
+
+    // The first declaration that looked at text the edit changes. Lexing restarts right after the declaration
+    // before it, so the blanks and comments in between are lexed again too.
+    auto unaffected = [&](const Declaration &decl) { return lookaheadEnd(decl) < edit.begin; };
+    size_t first =
+        std::partition_point(declarations.begin(), declarations.end(), unaffected) - declarations.begin();
+    for (size_t i = 0; i < first; i++) {
+        if (declarations[i].openEnded) first = i; // Ends the loop
+    }
+    uint32_t restartToken = first ? declarations[first - 1].endToken : 0;
+
+    size_t offset = 0;
+    int line = 1;
+    int col = 1;
+    if (restartToken > 0) {
+        uint32_t last = restartToken - 1;
+        offset = tokens->end(last);
+        line = tokens->line(last);
+        col = tokens->col(last) + static_cast<int>(tokens->end(last) - tokens->offset(last));
+    }
+
+    // Parse until the next token is where an old declaration after the edit now starts, on the same column:
+    // from there on the text and so the tokens are the same as before
+    Parser parser{next, offset, line, col};
+    std::vector<Declaration> fresh;
+    size_t resync = first;
+    bool resynced = false;
+    while (true) {
+        size_t index = parser.peekIndex();
+        int64_t position = parser.getTokens().offset(index);
+
+        while (resync < declarations.size() && (begin(declarations[resync]) < edit.end ||
+                                                begin(declarations[resync]) + shift < position)) {
+            resync++;
+        }
+        if (resync < declarations.size() && begin(declarations[resync]) + shift == position &&
+            tokens->col(declarations[resync].firstToken) == parser.getTokens().col(index)) {
+            resynced = true;
+            break;
+        }
+        if (parser.isAtEnd()) break;
+
+        size_t errors = parser.getDiagnostics().size();
+        StmtPtr stmt = parser.parseDeclaration(*program.arena);
+        size_t end = parser.peekIndex();
+        fresh.push_back({static_cast<uint32_t>(index), static_cast<uint32_t>(end), stmt, next, 0,
+                         {parser.getDiagnostics().begin() + errors, parser.getDiagnostics().end()},
+                         isOpenEnded(parser.getTokens(), index, end)});
+    }
+
+    // Without a resync point the new tokens run up to and including T_EOF
+    size_t freshEnd = parser.peekIndex() + (resynced ? 0 : 1);
+    uint32_t replacedEnd = resynced ? declarations[resync].firstToken : static_cast<uint32_t>(tokens->size());
+    int lineShift = resynced ? parser.getTokens().line(freshEnd) - tokens->line(replacedEnd) : 0;
+    int64_t tokenShift = static_cast<int64_t>(restartToken + freshEnd) - replacedEnd;
+
+    // Copy first if someone besides program.tokens holds the stream
+    if (tokens.use_count() > 2) tokens = std::make_shared<TokenStream>(*tokens);
+    tokens->replace(restartToken, replacedEnd, parser.getTokens(), 0, freshEnd, shift, lineShift);
+
+    if (restartToken > 0) {
+        Relocator relocator{0, restartToken};
+        for (Declaration &decl : fresh) {
+            decl.firstToken += restartToken;
+            decl.endToken += restartToken;
+            if (decl.stmt) relocator.relocate(*decl.stmt);
+        }
+    }
+
+    if (!resynced) resync = declarations.size();
+    Relocator relocator{lineShift, tokenShift};
+    for (size_t i = resync; i < declarations.size(); i++) {
+        Declaration &decl = declarations[i];
+        decl.firstToken = static_cast<uint32_t>(decl.firstToken + tokenShift);
+        decl.endToken = static_cast<uint32_t>(decl.endToken + tokenShift);
+        decl.textShift += shift;
+        if (decl.stmt && (lineShift != 0 || tokenShift != 0)) relocator.relocate(*decl.stmt);
+        for (Diagnostic &diagnostic : decl.diagnostics) diagnostic.line += lineShift;
+    }
+
+    declarations.erase(declarations.begin() + first, declarations.begin() + resync);
+    declarations.insert(declarations.begin() + first, std::make_move_iterator(fresh.begin()),
+                        std::make_move_iterator(fresh.end()));
+
+    program.tokens = tokens;
+    rebuildStatements();
+    reparsed = fresh.size();
+    reparsedSinceFull += fresh.size();
+    releaseUnused();
+    if (versions.size() > MAX_VERSIONS) moveToCurrentText();
+    return true;
+}
+
+// A quote without a closing one is only an ERROR token because no quote follows anywhere in the file, and a
+// string ending in \" could still grow up to a later quote. Either can change with an edit anywhere after it.
+bool IncrementalParser::isOpenEnded(const TokenStream &tokens, size_t first, size_t end) {
+    std::string_view text = tokens.getText();
+    for (size_t i = first; i < end; i++) {
+        if (tokens.type(i) == ERROR && text[tokens.offset(i)] == '"') return true;
+        if (tokens.type(i) == STRING && text[tokens.end(i) - 2] == '\\') return true;
+    }
+    return false;
+}
+
+std::vector<Diagnostic> IncrementalParser::getDiagnostics() const {
+    std::vector<Diagnostic> all;
+    for (const Declaration &decl : declarations) {
+        for (Diagnostic diagnostic : decl.diagnostics) {
+            diagnostic.fileId = fileId; // Older versions may be released, they all have the same name
+            all.push_back(std::move(diagnostic));
+        }
+    }
+    return all;
+}
+
+void IncrementalParser::rebuildStatements() {
+    program.statements.clear();
+    for (const Declaration &decl : declarations) {
+        if (decl.stmt) program.statements.push_back(decl.stmt);
+    }
+}
+
+void IncrementalParser::moveToCurrentText() {
+    const SourceFile &current = Sources::get(fileId);
+    for (Declaration &decl : declarations) {
+        if (decl.version == fileId) continue;
+        if (decl.stmt) {
+            Relocator relocator{0, 0};
+            relocator.rebase(Sources::get(decl.version), current, fileId, decl.textShift);
+            relocator.relocate(*decl.stmt);
+        }
+        decl.version = fileId;
+        decl.textShift = 0;
+    }
+    releaseUnused();
+}
+
+void IncrementalParser::releaseUnused() {
+    std::erase_if(versions, [&](FileId version) {
+        if (version == fileId) return false;
+        bool used = std::any_of(declarations.begin(), declarations.end(),
+                                [&](const Declaration &decl) { return decl.version == version; });
+        if (!used) Sources::release(version);
+        return !used;
+    });
+}
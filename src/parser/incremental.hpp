@@ -0,0 +1,79 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "errors.hpp"
+#include "program.hpp"
+#include "source.hpp"
+#include "token_stream.hpp"
+
+// Replaces the bytes [begin, end) of the current text with `text`
+struct TextEdit {
+    size_t begin;
+    size_t end;
+    std::string text;
+};
+
+// Keeps a parsed file up to date under edits. The file is parsed one top-level declaration at a time and the
+// token range of each is remembered; an edit re-lexes and re-parses from the first declaration it touches
+// until the new tokens line up with an old declaration boundary again, and keeps every other declaration.
+//
+// Each edit registers the new text as a new SourceFile. Kept nodes still point into the version they were
+// lexed from, so a version is only released once none of its declarations is left, or once too many versions
+// are alive and the remaining declarations are moved over to the current text. Moving a declaration (to a
+// new text, or to new line numbers and token indices after an edit above it) is a walk over its nodes but no
+// lexing or allocation.
+class IncrementalParser {
+  public:
+    explicit IncrementalParser(FileId fileId);
+    ~IncrementalParser();
+    IncrementalParser(const IncrementalParser &) = delete;
+    IncrementalParser &operator=(const IncrementalParser &) = delete;
+
+    // Returns false, leaving everything as it was, if the edit is not within the current text
+    bool apply(const TextEdit &edit);
+
+    Program &getProgram() { return program; }
+    FileId getFileId() const { return fileId; }
+    std::string_view getText() const { return Sources::get(fileId).getText(); }
+    std::vector<Diagnostic> getDiagnostics() const;
+
+    // Declarations parsed by the last apply(), or by the full parse it fell back to
+    size_t getReparsed() const { return reparsed; }
+
+  private:
+    struct Declaration {
+        uint32_t firstToken; // Into program.tokens
+        uint32_t endToken;   // One past the last token
+        StmtPtr stmt;        // nullptr when it has a syntax error
+        FileId version;
+        int64_t textShift; // Its offset in the current text minus its offset in `version`
+        std::vector<Diagnostic> diagnostics;
+        bool openEnded; // Its tokens depend on text after it, see isOpenEnded()
+    };
+
+    // Past this many live versions, declarations still in older ones are moved to the current text
+    static constexpr size_t MAX_VERSIONS = 8;
+
+    std::string name;
+    FileId fileId;
+    Program program;
+    std::shared_ptr<TokenStream> tokens; // program.tokens, updated in place unless someone else holds it
+    std::vector<Declaration> declarations;
+    std::vector<FileId> versions; // Versions created by apply() that are still referenced
+    size_t reparsed = 0;
+    size_t reparsedSinceFull = 0; // Replaced nodes stay in the arena until the next full parse
+
+    void parseAll();
+    static bool isOpenEnded(const TokenStream &tokens, size_t first, size_t end);
+    void rebuildStatements();
+    void releaseUnused();
+    void moveToCurrentText();
+
+    uint32_t begin(const Declaration &decl) const { return tokens->offset(decl.firstToken); }
+    // The parser peeks at the token after a declaration (for an `else`, another operator, or where to
+    // synchronize), so what a declaration parses to depends on the text up to the end of that token
+    uint32_t lookaheadEnd(const Declaration &decl) const { return tokens->end(decl.endToken); }
+};
@@ -0,0 +1,117 @@
+#include "parse_cache.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
+
+#include "binary_io.hpp"
+#include "flat_ast.hpp"
+
+#ifndef MARBL_VERSION
+#define MARBL_VERSION "unknown"
+#endif
+
+namespace {
+constexpr char MAGIC[8] = {'M', 'R', 'B', 'L', 'A', 'S', 'T', '\0'};
+
+// Layout of an entry: the header, the source text it was parsed from, then the body: the symbol names, the
+// tokens and the nodes. The file name is only a 64-bit hash of the text, so a hit compares the text itself
+// before trusting anything else. The body's hash catches truncated or corrupted files.
+struct Header {
+    char magic[8];
+    uint32_t format;
+    uint64_t textSize;
+    uint64_t bodySize;
+    uint64_t bodyHash;
+};
+} // namespace
+
+ParseCache::ParseCache(std::filesystem::path directory) : directory(std::move(directory)) {
+    std::error_code ec;
+    std::filesystem::create_directories(this->directory, ec);
+}
+
+std::filesystem::path ParseCache::entryPath(std::string_view text) const {
+    uint64_t key = BinaryIO::hash(MARBL_VERSION);
+    key = BinaryIO::hash(std::string_view(reinterpret_cast<const char *>(&FORMAT), sizeof(FORMAT)), key);
+    key = BinaryIO::hash(text, key);
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.ast", static_cast<unsigned long long>(key));
+    return directory / name;
+}
+
+std::optional<Program> ParseCache::load(FileId fileId) const {
+    std::string_view text = Sources::get(fileId).getText();
+    // Everything read from the entry is copied out of it, so it is not registered
+    std::unique_ptr<SourceFile> entry = Sources::open(entryPath(text).string());
+    if (!entry) return std::nullopt;
+    return read(fileId, entry->getText());
+}
+
+std::optional<Program> ParseCache::read(FileId fileId, std::string_view data) {
+    std::string_view text = Sources::get(fileId).getText();
+    Header header;
+    if (data.size() < sizeof(Header)) return std::nullopt;
+    std::memcpy(&header, data.data(), sizeof(Header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.format != FORMAT ||
+        header.textSize != text.size() || data.size() - sizeof(Header) < text.size() ||
+        data.substr(sizeof(Header), text.size()) != text) {
+        return std::nullopt;
+    }
+    std::string_view body = data.substr(sizeof(Header) + text.size());
+    if (header.bodySize != body.size() || header.bodyHash != BinaryIO::hash(body)) return std::nullopt;
+
+    BinaryReader in{body};
+    std::vector<Symbol> symbols;
+    uint64_t symbolCount = in.varint();
+    for (uint64_t i = 0; i < symbolCount && in.ok(); i++) symbols.push_back(Symbols::intern(in.string()));
+    in.setSymbols(std::move(symbols));
+
+    std::optional<TokenStream> tokens = TokenStream::read(in, fileId, text);
+    if (!tokens) return std::nullopt;
+    std::optional<FlatAst> flat = FlatAst::read(in, std::make_shared<const TokenStream>(std::move(*tokens)));
+    if (!flat || !in.atEnd()) return std::nullopt;
+
+    return flat->unflatten();
+}
+
+void ParseCache::store(FileId fileId, Program &program) const {
+    std::string_view text = Sources::get(fileId).getText();
+
+    BinaryWriter content;
+    program.tokens->write(content);
+    FlatAst::build(program).write(content);
+
+    // The symbol table is only complete once everything else is written, but is read first
+    BinaryWriter body;
+    body.varint(content.getSymbols().size());
+    for (Symbol symbol : content.getSymbols()) body.string(Symbols::name(symbol));
+    body.bytes(content.getBuffer());
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.format = FORMAT;
+    header.textSize = text.size();
+    header.bodySize = body.getBuffer().size();
+    header.bodyHash = BinaryIO::hash(body.getBuffer());
+
+    std::filesystem::path path = entryPath(text);
+    std::ostringstream suffix;
+    suffix << ".tmp" << getpid() << "-" << std::this_thread::get_id();
+    std::filesystem::path temporary = path;
+    temporary += suffix.str();
+
+    std::ofstream file(temporary, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+    file.write(text.data(), static_cast<std::streamsize>(text.size()));
+    file.write(body.getBuffer().data(), static_cast<std::streamsize>(body.getBuffer().size()));
+    file.close();
+
+    std::error_code ec;
+    if (file) std::filesystem::rename(temporary, path, ec);
+    if (!file || ec) std::filesystem::remove(temporary, ec);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+
+#include "program.hpp"
+#include "source.hpp"
+
+// Parsed programs stored in a directory, one file per source text. An entry is named after a hash of the
+// text and of the compiler version, so editing a file or upgrading the compiler simply misses, and stale
+// entries are never read. Only programs without syntax errors are stored: a hit has no diagnostics.
+//
+// An entry holds a copy of the text it was parsed from, the program's tokens and its FlatAst along with the
+// names of the symbols they use. Loading one compares the text, re-interns those names and unflattens the
+// nodes, without running the lexer or the parser. An entry whose text differs, or whose tokens or nodes do
+// not check out, is a miss.
+class ParseCache {
+  public:
+    explicit ParseCache(std::filesystem::path directory);
+
+    // The program for `fileId`'s text if an entry for it exists and reads back intact
+    std::optional<Program> load(FileId fileId) const;
+    // Best effort: a cache that cannot be written only costs a parse next time. Writing goes through a
+    // temporary file and a rename, so concurrent compilers never see half an entry.
+    void store(FileId fileId, Program &program) const;
+
+  private:
+    // Bump whenever the AST, the tokens or the encoding change. MARBL_VERSION alone does not cover builds
+    // made between releases.
+    static constexpr uint32_t FORMAT = 3;
+
+    std::filesystem::path directory;
+
+    std::filesystem::path entryPath(std::string_view text) const;
+    static std::optional<Program> read(FileId fileId, std::string_view entry);
+};
@@ -1,46 +1,111 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cctype>
 #include <cstdarg>
 #include <lexer.hpp>
 #include <memory>
 
 #include "ast.hpp"
-#include "parser_exception.hpp"
+#include "errors.hpp"
+#include "program.hpp"
 #include "tokens.hpp"
 
+// How the parser gets its tokens: Pull lexes one token at a time as the parser asks for it, Prelexed lexes
+// the whole file into the token stream before parsing starts.
+enum class LexMode { Pull, Prelexed };
+
 class Parser {
   public:
     Lexer lexer;
 
-    Parser(std::istream &input, std::string input_name) : lexer(input, input_name) {}
+    explicit Parser(FileId fileId, LexMode mode = LexMode::Prelexed)
+        : lexer(fileId), tokens(std::make_shared<TokenStream>(lexer.getFileId(), lexer.getText())) {
+        if (mode == LexMode::Prelexed) lexAll();
+    }
+    Parser(std::istream &input, std::string input_name, LexMode mode = LexMode::Prelexed)
+        : lexer(input, input_name),
+          tokens(std::make_shared<TokenStream>(lexer.getFileId(), lexer.getText())) {
+        if (mode == LexMode::Prelexed) lexAll();
+    }
+    // Parses from the middle of a file, lexing as it goes (see Lexer)
+    Parser(FileId fileId, size_t offset, int line, int col)
+        : lexer(fileId, offset, line, col),
+          tokens(std::make_shared<TokenStream>(lexer.getFileId(), lexer.getText())) {}
+
+    Program parse() {
+        Program program;
+        arena = program.arena.get();
+        while (!isAtEnd()) {
+            if (StmtPtr stmt = declaration()) program.statements.push_back(stmt);
+        }
+
+        program.tokens = tokens;
+        return program;
+    }
 
-    std::vector<UniqueStmt> parse() {
-        std::vector<UniqueStmt> statements;
-        while (!isAtEnd()) { statements.push_back(declaration()); }
+    bool isAtEnd() { return peekType() == TokenType::T_EOF; }
+    const TokenStream &getTokens() const { return *tokens; }
+    std::shared_ptr<TokenStream> shareTokens() const { return tokens; }
 
-        return statements;
+    // One top-level declaration at a time, for callers that track where each one starts and ends (see
+    // IncrementalParser). Returns nullptr for a declaration with a syntax error.
+    StmtPtr parseDeclaration(AstArena &into) {
+        arena = &into;
+        return declaration();
     }
+    // Index in getTokens() of the next token, lexing it if needed
+    size_t peekIndex() { return fill(current); }
 
-    bool isAtEnd() { return peek().tokenType == TokenType::T_EOF; }
+    // Syntax errors of the last parse(), in source order. Declarations that had one are left out of the
+    // program.
+    const std::vector<Diagnostic> &getDiagnostics() const { return diagnostics; }
+    bool hadError() const { return !diagnostics.empty(); }
 
   private:
+    std::shared_ptr<TokenStream> tokens;
+    size_t current = 0;
+    bool lexedAll = false;
     Token previousToken;
+    AstArena *arena = nullptr;
+
+    std::vector<Diagnostic> diagnostics;
+    bool panicMode = false; // Set by the first error of a declaration, silences the rest until synchronized
+
+    template <typename T, typename... Args> T *make(Args &&...args) {
+        return arena->make<T>(std::forward<Args>(args)...);
+    }
+
+    template <typename T> AstList<T> list() { return AstList<T>(arena->getResource()); }
 
-    Token peek() {
-        if (lexer.currentToken.tokenType == TokenType::T_SOF) lexer.nextToken();
-        return lexer.currentToken;
+    void lexAll() {
+        lexer.tokenize(*tokens);
+        lexedAll = true;
+    }
+
+    // Makes sure token `i` is lexed and returns its index, clamped to the T_EOF token
+    size_t fill(size_t i) {
+        while (!lexedAll && tokens->size() <= i) {
+            lexedAll = lexer.nextToken() == TokenType::T_EOF;
+            tokens->push(lexer.currentToken());
+        }
+        return std::min(i, tokens->size() - 1);
     }
 
-    Token advance() {
+    TokenType peekType(size_t k = 0) { return tokens->type(fill(current + k)); }
+    Token peek(size_t k = 0) { return tokens->at(fill(current + k)); }
+
+    const Token &advance() {
         // Consumes the current token and returns it
-        previousToken = lexer.currentToken;
-        if (!isAtEnd()) lexer.nextToken();
+        previousToken = peek();
+        if (!isAtEnd()) current++;
         return previousToken;
     }
 
     bool check(TokenType type) {
         if (isAtEnd()) return false;
-        return peek().tokenType == type;
+        return peekType() == type;
     }
 
     template <typename... Types> bool match(Types... types) {
@@ -54,14 +119,32 @@ class Parser {
         return false;
     }
 
+    // ======= Errors =======
+    // Errors do not unwind: the failing rule records a diagnostic, enters panic mode and returns a null node,
+    // and the enclosing declaration() drops what was parsed and skips to the next statement boundary.
+
+    void error(const Token &token, std::string message) {
+        if (panicMode) return;
+        panicMode = true;
+        diagnostics.push_back(Errors::at(token, std::move(message)));
+    }
+
+    // Skips tokens until just after a ';' or just before a keyword that starts a statement
     void synchronize() {
-        advance();
+        panicMode = false;
 
         while (!isAtEnd()) {
             if (previousToken.tokenType == SEMICOLON) return;
 
-            switch (peek().tokenType) {
-            case CLASS | FUN | LET | FOR | IF | WHILE | PRINT | RETURN:
+            switch (peekType()) {
+            case CLASS:
+            case FUN:
+            case LET:
+            case FOR:
+            case IF:
+            case WHILE:
+            case PRINT:
+            case RETURN:
                 return;
             default:
                 break;
@@ -71,227 +154,234 @@ class Parser {
         }
     }
 
-    Token consume(TokenType type, std::string msg) {
+    // On a mismatch, reports the error and returns the previous token in place of the expected one
+    const Token &consume(TokenType type, const std::string &msg) {
         if (check(type)) return advance();
-        throw ParserException(peek(), msg);
+        error(peek(), msg);
+        return previousToken;
     }
 
-    UniqueExpr primary() {
-        // primary        ::= "true" | "false" | "this"
-        //                |   NUMBER | STRING | IDENTIFIER | "(" expression ")"
-        //                |   "super" "." IDENTIFIER ; // TODO
-
-        if (match(TRUE)) return std::make_unique<Literal>(true);
-        if (match(FALSE)) return std::make_unique<Literal>(false);
-        // if (match(THIS)) return std::make_unique<Literal>(THIS); // TODO
-
-        if (match(NUMBER, STRING)) return std::make_unique<Literal>(previousToken.literal);
-        if (match(IDENTIFIER)) return std::make_unique<Variable>(previousToken);
-
-        if (match(LEFT_PAREN)) {
-            UniqueExpr expr = expression();
-            consume(RIGHT_PAREN, "Except ')' after expression.");
-            return std::make_unique<Grouping>(std::move(expr));
-        }
-
-        throw ParserException(peek(), "Expect expression.");
+    // ======= Expressions =======
+    // Pratt parser: every token type has an entry in a rule table giving what it parses as at the start of an
+    // expression (prefix), what it parses as after an operand (infix) and how tightly that infix binds. A new
+    // operator is a new table entry.
+    //
+    // expression     ::= assignment ;
+    // assignment     ::= IDENTIFIER "=" assignment | logic_or ;
+    // logic_or       ::= logic_and ( "or" logic_and )* ;
+    // logic_and      ::= equality ( "and" equality )* ;
+    // equality       ::= comparison ( ( "!=" | "==" ) comparison )* ;
+    // comparison     ::= term ( ( ">" | ">=" | "<" | "<=" ) term )* ;
+    // term           ::= factor ( ( "-" | "+" ) factor )* ;
+    // factor         ::= unary ( ( "/" | "*" ) unary )* ;
+    // unary          ::= ( "!" | "-" ) unary | call ;
+    // call           ::= primary ( "(" arguments? ")" )* ;
+    // primary        ::= "true" | "false" | NUMBER | STRING | IDENTIFIER | "(" expression ")" ;
+
+    enum class Precedence : uint8_t {
+        NONE,
+        ASSIGNMENT, // =
+        OR,         // or
+        AND,        // and
+        EQUALITY,   // == !=
+        COMPARISON, // < > <= >=
+        TERM,       // + -
+        FACTOR,     // * /
+        UNARY,      // ! -
+        CALL,       // ()
+    };
+
+    using PrefixFn = ExprPtr (Parser::*)();
+    using InfixFn = ExprPtr (Parser::*)(ExprPtr left);
+
+    struct ParseRule {
+        PrefixFn prefix = nullptr;
+        InfixFn infix = nullptr;
+        Precedence precedence = Precedence::NONE;
+    };
+
+    static constexpr size_t RULE_COUNT = T_EOF + 1;
+
+    static constexpr std::array<ParseRule, RULE_COUNT> makeRules() {
+        std::array<ParseRule, RULE_COUNT> rules{};
+        rules[LEFT_PAREN] = {&Parser::grouping, &Parser::finishCall, Precedence::CALL};
+        rules[MINUS] = {&Parser::unary, &Parser::binary, Precedence::TERM};
+        rules[PLUS] = {nullptr, &Parser::binary, Precedence::TERM};
+        rules[SLASH] = {nullptr, &Parser::binary, Precedence::FACTOR};
+        rules[STAR] = {nullptr, &Parser::binary, Precedence::FACTOR};
+        rules[BANG] = {&Parser::unary, nullptr, Precedence::NONE};
+        rules[BANG_EQUAL] = {nullptr, &Parser::binary, Precedence::EQUALITY};
+        rules[EQUAL] = {nullptr, &Parser::assignment, Precedence::ASSIGNMENT};
+        rules[EQUAL_EQUAL] = {nullptr, &Parser::binary, Precedence::EQUALITY};
+        rules[GREATER] = {nullptr, &Parser::binary, Precedence::COMPARISON};
+        rules[GREATER_EQUAL] = {nullptr, &Parser::binary, Precedence::COMPARISON};
+        rules[LESS] = {nullptr, &Parser::binary, Precedence::COMPARISON};
+        rules[LESS_EQUAL] = {nullptr, &Parser::binary, Precedence::COMPARISON};
+        rules[AND] = {nullptr, &Parser::logical, Precedence::AND};
+        rules[OR] = {nullptr, &Parser::logical, Precedence::OR};
+        rules[TRUE] = {&Parser::literal, nullptr, Precedence::NONE};
+        rules[FALSE] = {&Parser::literal, nullptr, Precedence::NONE};
+        rules[NUMBER] = {&Parser::literal, nullptr, Precedence::NONE};
+        rules[STRING] = {&Parser::literal, nullptr, Precedence::NONE};
+        rules[IDENTIFIER] = {&Parser::variable, nullptr, Precedence::NONE};
+        return rules;
     }
 
-    UniqueExpr finishCall(UniqueExpr callee) {
-        std::vector<UniqueExpr> args{};
-        if (!check(RIGHT_PAREN)) {
-            do { args.push_back(expression()); } while (match(COMMA));
-        }
-
-        Token paren = consume(RIGHT_PAREN, "Expect ')' after arguments.");
-        return std::make_unique<Call>(std::move(callee), paren, std::move(args));
+    static const ParseRule &rule(TokenType type) {
+        static constexpr std::array<ParseRule, RULE_COUNT> rules = makeRules();
+        static constexpr ParseRule none{};
+        return type < 0 ? none : rules[type];
     }
 
-    UniqueExpr call() {
-        // call           ::= primary ( "(" arguments? ")" | "." IDENTIFIER )* ;
-        UniqueExpr expr = primary();
-
-        while (true) {
-            if (match(LEFT_PAREN)) {
-                expr = finishCall(std::move(expr));
-            } else
-                break;
-        }
-
-        // if (match(LEFT_PAREN)) {
-        //     std::vector<UniqueExpr> args{};
-
-        //     Token paren = consume(RIGHT_PAREN, "Expect ')' after arguments.");
-        //     return std::make_unique<Call>(std::move(expr), paren, std::move(args));
-        // }
-
-        return expr;
+    static Precedence next(Precedence precedence) {
+        return static_cast<Precedence>(static_cast<uint8_t>(precedence) + 1);
     }
 
-    UniqueExpr unary() {
-        // unary          ::= ( "!" | "-" ) unary | call ;
-        if (match(BANG, MINUS)) {
-            Token op = previousToken;
-            UniqueExpr right = unary();
-            return std::make_unique<Unary>(op, std::move(right));
+    // Parses an expression whose operators all bind at least as tightly as `precedence`
+    ExprPtr parsePrecedence(Precedence precedence) {
+        PrefixFn prefix = rule(peekType()).prefix;
+        if (!prefix) {
+            // The scanners turn numbers that do not fit their type into ERROR tokens
+            Token token = peek();
+            char first = token.lexeme.empty() ? '\0' : token.lexeme[0];
+            bool number = token.tokenType == ERROR && (std::isdigit(static_cast<unsigned char>(first)) ||
+                                                       first == '.');
+            error(token, number ? "Number literal out of range." : "Expect expression.");
+            return nullptr;
         }
 
-        return call();
-    }
-
-    UniqueExpr factor() {
-        // factor         ::= unary ( ( "/" | "*" ) unary )* ;
-        UniqueExpr expr = unary();
+        advance();
+        ExprPtr left = (this->*prefix)();
 
-        while (match(SLASH, STAR)) {
-            Token op = previousToken;
+        while (true) {
+            const ParseRule &infix = rule(peekType());
+            if (!infix.infix || infix.precedence < precedence) break;
 
-            UniqueExpr right = unary();
-            expr = std::make_unique<Binary>(std::move(expr), op, std::move(right));
+            advance();
+            left = (this->*infix.infix)(left);
         }
 
-        return expr;
+        return left;
     }
 
-    UniqueExpr term() {
-        // term           ::= factor ( ( "-" | "+" ) factor )* ;
-        UniqueExpr expr = factor();
-
-        while (match(MINUS, PLUS)) {
-            Token op = previousToken;
-
-            UniqueExpr right = factor();
-            expr = std::make_unique<Binary>(std::move(expr), op, std::move(right));
+    ExprPtr literal() {
+        switch (previousToken.tokenType) {
+        case TRUE:
+            return make<Literal>(previousToken, true);
+        case FALSE:
+            return make<Literal>(previousToken, false);
+        default:
+            return make<Literal>(previousToken, previousToken.literal);
         }
-
-        return expr;
     }
 
-    UniqueExpr comparison() {
-        // comparison     ::= term ( ( ">" | ">=" | "<" | "<=" ) term )* ;
-        UniqueExpr expr = term();
-
-        while (match(GREATER, GREATER_EQUAL, LESS, LESS_EQUAL)) {
-            Token op = previousToken;
-
-            UniqueExpr right = term();
-            expr = std::make_unique<Binary>(std::move(expr), op, std::move(right));
-        }
+    ExprPtr variable() { return make<Variable>(previousToken); }
 
-        return expr;
+    ExprPtr grouping() {
+        ExprPtr expr = expression();
+        consume(RIGHT_PAREN, "Except ')' after expression.");
+        return make<Grouping>(expr);
     }
 
-    UniqueExpr equality() {
-        // equality       ::= comparison ( ( "!=" | "==" ) comparison )* ;
-        UniqueExpr expr = comparison();
-
-        while (match(BANG_EQUAL, EQUAL_EQUAL)) {
-            Token op = previousToken;
-
-            UniqueExpr right = comparison();
-            expr = std::make_unique<Binary>(std::move(expr), op, std::move(right));
-        }
-
-        return expr;
+    ExprPtr unary() {
+        Token op = previousToken;
+        ExprPtr right = parsePrecedence(Precedence::UNARY);
+        return make<Unary>(op, right);
     }
 
-    UniqueExpr logic_and() {
-        // logic_and      → equality ( "and" equality )* ;
-        UniqueExpr res = equality();
-
-        while (match(AND)) {
-            Token op = previousToken;
-            UniqueExpr right = equality();
-            res = std::make_unique<Logical>(std::move(res), op, std::move(right));
-        }
-
-        return res;
+    // Left-associative: the right operand only takes operators that bind tighter than this one
+    ExprPtr binary(ExprPtr left) {
+        Token op = previousToken;
+        ExprPtr right = parsePrecedence(next(rule(op.tokenType).precedence));
+        return make<Binary>(left, op, right);
     }
 
-    UniqueExpr logic_or() {
-        // logic_or       → logic_and ( "or" logic_and )* ;
-        UniqueExpr res = logic_and();
-
-        while (match(OR)) {
-            Token op = previousToken;
-            UniqueExpr right = logic_and();
-            res = std::make_unique<Logical>(std::move(res), op, std::move(right));
-        }
-
-        return res;
+    ExprPtr logical(ExprPtr left) {
+        Token op = previousToken;
+        ExprPtr right = parsePrecedence(next(rule(op.tokenType).precedence));
+        return make<Logical>(left, op, right);
     }
 
-    UniqueExpr assignment() {
-        // assignment     ::= ( call "." )? IDENTIFIER "=" assignment
-        //                |   logic_or ;
-        UniqueExpr expr = logic_or();
-
-        if (match(EQUAL)) {
-            Token equals = previousToken;
-            UniqueExpr value = assignment();
+    // Right-associative, and only a variable can be assigned to
+    ExprPtr assignment(ExprPtr target) {
+        Token equals = previousToken;
+        ExprPtr value = parsePrecedence(Precedence::ASSIGNMENT);
 
-            if (auto *var = dynamic_cast<Variable *>(expr.get())) {
-                Token name = var->name;
-                return std::make_unique<Assign>(name, std::move(value));
-            }
+        if (auto *var = target ? target->as<Variable>() : nullptr) return make<Assign>(var->name, value);
+        error(equals, "Invalid assignment target.");
+        return nullptr;
+    }
 
-            throw std::runtime_error("Invalid assignment target.");
+    ExprPtr finishCall(ExprPtr callee) {
+        AstList<ExprPtr> args = list<ExprPtr>();
+        if (!check(RIGHT_PAREN)) {
+            do { args.push_back(expression()); } while (match(COMMA));
         }
 
-        return expr;
+        Token paren = consume(RIGHT_PAREN, "Expect ')' after arguments.");
+        return make<Call>(callee, paren, std::move(args));
     }
 
-    UniqueExpr expression() {
-        // expression     ::= assignment ;
-        return assignment();
-    }
+    ExprPtr expression() { return parsePrecedence(Precedence::ASSIGNMENT); }
 
-    UniqueStmt expressionStatement() {
+    StmtPtr expressionStatement() {
         // exprStmt        ::= expression ";" ;
-        UniqueExpr value = expression();
+        ExprPtr value = expression();
         consume(SEMICOLON, "Expect ';' after value.");
-        return std::make_unique<Expression>(std::move(value));
+        return make<Expression>(value);
     }
 
-    UniqueStmt printStatement() {
+    StmtPtr printStatement() {
         // printStmt       ::= "print" expression ";" ;
-        UniqueExpr value = expression();
+        ExprPtr value = expression();
         consume(SEMICOLON, "Expect ';' after value.");
-        return std::make_unique<Print>(std::move(value));
+        return make<Print>(value);
     }
 
-    std::vector<UniqueStmt> block() {
+    AstList<StmtPtr> block() {
         // block           ::= "{" declaration* "}" ;
-        std::vector<UniqueStmt> statements{};
+        AstList<StmtPtr> statements = list<StmtPtr>();
 
-        while (!check(RIGHT_BRACE) && !isAtEnd()) statements.push_back(declaration());
+        while (!check(RIGHT_BRACE) && !isAtEnd()) {
+            if (StmtPtr stmt = declaration()) statements.push_back(stmt);
+        }
 
         consume(RIGHT_BRACE, "Expect '}' at end of block.");
-        return std::move(statements);
+        return statements;
     }
 
-    UniqueStmt ifStatement() {
+    StmtPtr ifStatement() {
         consume(LEFT_PAREN, "Expect '(' after 'if'.");
-        UniqueExpr condition = expression();
+        ExprPtr condition = expression();
         consume(RIGHT_PAREN, "Expect ')' after if condition.");
 
-        UniqueStmt thenBranch = statement();
-        UniqueStmt elseBranch = nullptr;
+        StmtPtr thenBranch = statement();
+        StmtPtr elseBranch = nullptr;
         if (match(ELSE)) elseBranch = statement();
 
-        return std::make_unique<If>(std::move(condition), std::move(thenBranch), std::move(elseBranch));
+        return make<If>(condition, thenBranch, elseBranch);
     }
 
-    UniqueStmt whileStatement() {
+    StmtPtr whileStatement() {
         consume(LEFT_PAREN, "Expect '(' after 'while'.");
-        UniqueExpr condition = expression();
+        ExprPtr condition = expression();
         consume(RIGHT_PAREN, "Expect ')' after while condition.");
 
-        UniqueStmt body = statement();
-        return std::make_unique<While>(std::move(condition), std::move(body));
+        StmtPtr body = statement();
+        return make<While>(condition, body);
     }
 
-    UniqueStmt statement() {
+    StmtPtr returnStatement() {
+        // returnStmt      ::= "return" expression? ";" ;
+        Token keyword = previousToken;
+        ExprPtr value = nullptr;
+        if (!check(SEMICOLON)) value = expression();
+
+        consume(SEMICOLON, "Expect ';' after return value.");
+        return make<Return>(keyword, value);
+    }
+
+    StmtPtr statement() {
         // statement       ::= exprStmt
         //                 |   forStmt
         //                 |   ifStmt
@@ -300,65 +390,90 @@ class Parser {
         //                 |   whileStmt
         //                 |   block ;
         if (match(PRINT)) return printStatement();
+        if (match(RETURN)) return returnStatement();
         if (match(WHILE)) return whileStatement();
-        if (match(LEFT_BRACE)) return std::make_unique<Block>(block());
+        if (match(LEFT_BRACE)) return make<Block>(block());
         if (match(IF)) return ifStatement();
 
         return expressionStatement();
     }
 
-    UniqueStmt letDeclaration() {
-        // letDecl         ::= "let" IDENTIFIER ":" IDENTIFIER ( "=" expression )? ";" ;
+    // An optional ": type" after a variable, a parameter or a parameter list
+    ExprPtr typeAnnotation() {
+        // typeAnnotation  ::= ":" IDENTIFIER ;
+        if (!match(COLON)) return nullptr;
+        return make<TypeAnnotation>(consume(IDENTIFIER, "Expect type name after ':'."));
+    }
+
+    StmtPtr letDeclaration() {
+        // letDecl         ::= "let" IDENTIFIER typeAnnotation? ( "=" expression )? ";" ;
         Token name = consume(IDENTIFIER, "Expect variable name.");
+        ExprPtr annotation = typeAnnotation();
 
-        UniqueExpr initializer = nullptr;
+        ExprPtr initializer = nullptr;
         if (match(EQUAL)) { initializer = expression(); }
 
         consume(SEMICOLON, "Expect ';' after variable declaration");
-        return std::make_unique<Let>(name, std::move(initializer));
+        return make<Let>(name, annotation, initializer);
     }
 
-    UniqueStmt function(std::string kind) {
+    StmtPtr function(std::string kind) {
+        // function        ::= IDENTIFIER "(" parameters? ")" typeAnnotation? block ;
+        // parameters      ::= IDENTIFIER typeAnnotation? ( "," IDENTIFIER typeAnnotation? )* ;
         Token name = consume(IDENTIFIER, "Expect " + kind + " name.");
         consume(LEFT_PAREN, "Expect '(' after " + kind + " name.");
 
-        std::vector<Token> params{};
+        // Parameters are declarations without an initializer; the call provides their values
+        AstList<Let> params = list<Let>();
         if (!check(RIGHT_PAREN)) {
-            do { params.push_back(consume(IDENTIFIER, "Expect parameter name.")); } while (match(COMMA));
+            do {
+                Token param = consume(IDENTIFIER, "Expect parameter name.");
+                params.push_back(Let(param, typeAnnotation(), nullptr));
+            } while (match(COMMA));
         }
 
         consume(RIGHT_PAREN, "Expect ')' after parameters.");
+        ExprPtr returnAnnotation = typeAnnotation();
         consume(LEFT_BRACE, "Expect '{' before " + kind + " body.");
 
-        std::vector<UniqueStmt> body = block();
-        return std::make_unique<Function>(name, params, std::move(body));
+        AstList<StmtPtr> body = block();
+        return make<Function>(name, std::move(params), returnAnnotation, std::move(body));
     }
 
-    UniqueStmt classDeclaration() {
+    StmtPtr classDeclaration() {
         // classDecl         ::= "class" IDENTIFIER "{" function* "}" ;
         Token name = consume(IDENTIFIER, "Expect class name.");
         consume(LEFT_BRACE, "Expect '{' after class name.");
 
-        std::vector<Let> fields{};
-        std::vector<Function> methods{};
+        AstList<Let> fields = list<Let>();
+        AstList<Function> methods = list<Function>();
 
         consume(RIGHT_BRACE, "Expect '}' after class name.");
-        return std::make_unique<Class>(name, std::move(fields), std::move(methods));
+        return make<Class>(name, std::move(fields), std::move(methods));
     }
 
-    UniqueStmt declaration() {
+    StmtPtr declaration() {
         // declaration     ::= classDecl
         //                 |   funDecl
         //                 |   letDecl
         //                 |   statement ;
-        try {
-            if (match(CLASS)) return classDeclaration();
-            if (match(FUN)) return function("function");
-            if (match(LET)) return letDeclaration();
-            return statement();
-        } catch (ParserException err) {
+        size_t start = current;
+        size_t errors = diagnostics.size();
+
+        StmtPtr stmt;
+        if (match(CLASS)) stmt = classDeclaration();
+        else if (match(FUN)) stmt = function("function");
+        else if (match(LET)) stmt = letDeclaration();
+        else stmt = statement();
+
+        if (diagnostics.size() == errors && !panicMode) return stmt;
+
+        // A nested declaration may already have recovered; otherwise skip to the next statement. A
+        // declaration that failed on its first token would be retried forever without the extra advance().
+        if (panicMode) {
+            if (current == start) advance();
             synchronize();
-            return nullptr;
         }
+        return nullptr;
     }
 };
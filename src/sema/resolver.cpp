@@ -0,0 +1,146 @@
+#include "resolver.hpp"
+
+#include <limits>
+
+void Resolver::resolve(Program &program) {
+    beginScope(0);
+    declareBuiltins();
+
+    for (StmtPtr statement : program.statements) statement->accept(*this);
+    endScope();
+}
+
+void Resolver::resolveEntry(Program &entry) {
+    interactive = true;
+    diagnostics.clear();
+    reassignedGlobals.clear();
+    if (scopes.empty()) {
+        beginScope(0);
+        declareBuiltins();
+    }
+
+    for (StmtPtr statement : entry.statements) statement->accept(*this);
+}
+
+void Resolver::acceptEntry() {
+    for (Stmt *let : reassignedGlobals) let->reassigned = true;
+    reassignedGlobals.clear();
+}
+
+void Resolver::declareBuiltins() {
+    declare(Symbols::intern("clock"), nullptr);
+    declare(Symbols::intern("printf"), nullptr);
+}
+
+uint32_t Resolver::declare(Symbol name, Stmt *node) {
+    Scope &scope = scopes.back();
+    // A redeclaration gets a slot of its own; later uses see the new one
+    scope.names[name] = Declaration{scope.size, node};
+    return scope.size++;
+}
+
+Stmt *Resolver::bind(Expr &use, const Token &name) {
+    for (size_t i = scopes.size(); i-- > 0;) {
+        auto it = scopes[i].names.find(name.symbol());
+        if (it == scopes[i].names.end()) continue;
+
+        // Variables live in the frame of the function that declares them, which a nested function or a
+        // function called from the top level cannot see. Functions themselves can be called from anywhere,
+        // and so can the top-level lets of an interactive session, which are globals.
+        Stmt *node = it->second.node;
+        bool global = interactive && i == 0;
+        if (node && node->kind == NodeKind::Let && scopes[i].function != scopes.back().function && !global) {
+            diagnostics.push_back(Errors::at(
+                name, "Cannot capture '" + std::string(name.lexeme) +
+                          "': functions can only use their own parameters and variables."));
+        }
+        size_t depth = scopes.size() - 1 - i;
+        if (depth > std::numeric_limits<decltype(use.depth)>::max()) {
+            diagnostics.push_back(Errors::at(
+                name, "Too many scopes between '" + std::string(name.lexeme) + "' and its declaration."));
+            return nullptr;
+        }
+        use.depth = static_cast<uint16_t>(depth);
+        use.slot = it->second.slot;
+        return node;
+    }
+    diagnostics.push_back(Errors::at(name, "Undefined variable '" + std::string(name.lexeme) + "'."));
+    return nullptr;
+}
+
+// ======= Expressions =======
+
+void Resolver::visitBinaryExpr(Binary &expr) {
+    expr.left->accept(*this);
+    expr.right->accept(*this);
+}
+
+void Resolver::visitLogicalExpr(Logical &expr) {
+    expr.left->accept(*this);
+    expr.right->accept(*this);
+}
+
+void Resolver::visitUnaryExpr(Unary &expr) { expr.right->accept(*this); }
+
+void Resolver::visitGroupingExpr(Grouping &expr) { expr.expression->accept(*this); }
+
+void Resolver::visitVariableExpr(Variable &expr) { bind(expr, expr.name); }
+
+void Resolver::visitAssignExpr(Assign &expr) {
+    expr.value->accept(*this);
+    Stmt *target = bind(expr, expr.name);
+    if (!target) return;
+    if (interactive && expr.depth == scopes.size() - 1) {
+        reassignedGlobals.push_back(target);
+    } else {
+        target->reassigned = true;
+    }
+}
+
+void Resolver::visitCallExpr(Call &expr) {
+    expr.callee->accept(*this);
+    for (ExprPtr arg : expr.arguments) arg->accept(*this);
+}
+
+// ======= Statements =======
+
+void Resolver::visitExpressionStmt(Expression &stmt) { stmt.expression->accept(*this); }
+
+void Resolver::visitPrintStmt(Print &stmt) { stmt.expression->accept(*this); }
+
+void Resolver::visitIfStmt(If &stmt) {
+    stmt.condition->accept(*this);
+    stmt.thenBranch->accept(*this);
+    if (stmt.elseBranch) stmt.elseBranch->accept(*this);
+}
+
+void Resolver::visitWhileStmt(While &stmt) {
+    stmt.condition->accept(*this);
+    stmt.body->accept(*this);
+}
+
+void Resolver::visitLetStmt(Let &stmt) {
+    // Declared after the initializer, which still sees an outer variable of the same name
+    if (stmt.initializer) stmt.initializer->accept(*this);
+    stmt.slot = declare(stmt.name.symbol(), &stmt);
+}
+
+void Resolver::visitBlockStmt(Block &stmt) {
+    beginScope(scopes.back().function);
+    for (StmtPtr statement : stmt.statements) statement->accept(*this);
+    endScope();
+}
+
+void Resolver::visitFunctionStmt(Function &stmt) {
+    // Declared before the body so that the function can call itself
+    stmt.slot = declare(stmt.name.symbol(), &stmt);
+
+    beginScope(scopes.back().function + 1);
+    for (Let &param : stmt.params) param.slot = declare(param.name.symbol(), &param);
+    for (StmtPtr statement : stmt.body) statement->accept(*this);
+    endScope();
+}
+
+void Resolver::visitReturnStmt(Return &stmt) {
+    if (stmt.value) stmt.value->accept(*this);
+}
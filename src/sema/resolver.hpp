@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.hpp"
+#include "errors.hpp"
+#include "program.hpp"
+
+// Binds every use of a name to its declaration before anything else runs, so that later passes index
+// vectors instead of looking names up. Each scope numbers its declarations from 0 in source order; a Let or
+// a Function gets its number in Stmt::slot, and a Variable or an Assign gets the declaration's scope, counted
+// outwards from its own, and number in Expr::depth and Expr::slot. A Let that is assigned to after its
+// declaration is marked Stmt::reassigned.
+//
+// Scopes are the top level, each block and each function, whose parameters come first. The top level starts
+// with the builtins, clock then printf. Passes that keep their own scopes must open and fill them the same
+// way.
+class Resolver {
+  public:
+    void resolve(Program &program);
+    // Resolves one entry of an interactive session. Its top level keeps the declarations of the entries
+    // resolved before, so a Resolver must be kept for the whole session. Top-level lets are globals there,
+    // which functions can use too.
+    void resolveEntry(Program &entry);
+    // Marks the top-level lets the last entry assigns to as reassigned. Until the session accepts the entry
+    // they are left alone, since they may belong to earlier entries that must not change if it is rejected.
+    void acceptEntry();
+
+    // Undefined names and uses of variables a function cannot reach, in source order
+    const std::vector<Diagnostic> &getDiagnostics() const { return diagnostics; }
+    bool hadError() const { return !diagnostics.empty(); }
+
+    void visitLiteralExpr(Literal &) {}
+    void visitBinaryExpr(Binary &expr);
+    void visitLogicalExpr(Logical &expr);
+    void visitUnaryExpr(Unary &expr);
+    void visitGroupingExpr(Grouping &expr);
+    void visitVariableExpr(Variable &expr);
+    void visitAssignExpr(Assign &expr);
+    void visitCallExpr(Call &expr);
+    void visitTypeAnnotationExpr(TypeAnnotation &) {}
+
+    void visitExpressionStmt(Expression &stmt);
+    void visitPrintStmt(Print &stmt);
+    void visitIfStmt(If &stmt);
+    void visitWhileStmt(While &stmt);
+    void visitLetStmt(Let &stmt);
+    void visitBlockStmt(Block &stmt);
+    void visitFunctionStmt(Function &stmt);
+    void visitClassStmt(Class &) {}
+    void visitReturnStmt(Return &stmt);
+
+  private:
+    struct Declaration {
+        uint32_t slot;
+        Stmt *node; // The Let or Function; nullptr for a builtin
+    };
+
+    struct Scope {
+        std::unordered_map<Symbol, Declaration> names;
+        uint32_t size = 0;
+        uint32_t function; // How many functions enclose the scope; the top level is 0
+    };
+
+    std::vector<Scope> scopes;
+    std::vector<Diagnostic> diagnostics;
+    bool interactive = false;
+    std::vector<Stmt *> reassignedGlobals; // Marked by acceptEntry()
+
+    void beginScope(uint32_t function) { scopes.push_back(Scope{{}, 0, function}); }
+    void endScope() { scopes.pop_back(); }
+    void declareBuiltins();
+    uint32_t declare(Symbol name, Stmt *node);
+    // Sets the depth and slot of a use of `name` and returns what it refers to
+    Stmt *bind(Expr &use, const Token &name);
+};
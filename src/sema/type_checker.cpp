@@ -0,0 +1,382 @@
+#include "type_checker.hpp"
+
+#include <algorithm>
+
+namespace {
+// Where to report an error about an expression
+const Token &tokenOf(Expr &expr) {
+    switch (expr.kind) {
+    case NodeKind::Binary: return static_cast<Binary &>(expr).op;
+    case NodeKind::Grouping: return tokenOf(*static_cast<Grouping &>(expr).expression);
+    case NodeKind::Literal: return static_cast<Literal &>(expr).token;
+    case NodeKind::Unary: return static_cast<Unary &>(expr).op;
+    case NodeKind::Variable: return static_cast<Variable &>(expr).name;
+    case NodeKind::Assign: return static_cast<Assign &>(expr).name;
+    case NodeKind::Logical: return static_cast<Logical &>(expr).op;
+    case NodeKind::Call: return static_cast<Call &>(expr).paren;
+    case NodeKind::TypeAnnotation: return static_cast<TypeAnnotation &>(expr).name;
+    default: std::unreachable();
+    }
+}
+
+std::string quoted(const Token &token) { return "'" + std::string(token.lexeme) + "'"; }
+} // namespace
+
+void TypeChecker::check(Program &program) {
+    beginScope();
+    declareBuiltins();
+
+    for (StmtPtr statement : program.statements) statement->accept(*this);
+    endScope();
+    finish();
+}
+
+void TypeChecker::checkEntry(Program &entry) {
+    diagnostics.clear();
+    if (scopes.empty()) {
+        beginScope();
+        declareBuiltins();
+    }
+
+    for (StmtPtr statement : entry.statements) statement->accept(*this);
+    finish();
+}
+
+// The builtins, in the slots the resolver gave them
+void TypeChecker::declareBuiltins() {
+    signatures.push_back(Signature{{}, fresh(Type::Int), false});
+    declare(0, Binding{signatures.back().result, signatures.size() - 1});
+    signatures.push_back(Signature{{fresh(Type::String)}, fresh(Type::Int), true});
+    declare(1, Binding{signatures.back().result, signatures.size() - 1});
+}
+
+void TypeChecker::finish() {
+    for (const Check &check : checks) {
+        Type type = resolve(check.var);
+        bool ok = type != Type::Void;
+        if (check.requirement == Requirement::Number) ok = type == Type::Int || type == Type::Float;
+        if (check.requirement == Requirement::Scalar) ok = ok && type != Type::String;
+        if (!ok) error(check.token, check.message);
+    }
+    std::stable_sort(diagnostics.begin(), diagnostics.end(), [](const Diagnostic &a, const Diagnostic &b) {
+        return std::pair(a.line, a.col) < std::pair(b.line, b.col);
+    });
+
+    for (auto [expr, var] : typedExprs) expr->type = settle(var);
+    for (auto [stmt, var] : typedStmts) stmt->declaredType = settle(var);
+    checks.clear();
+    typedExprs.clear();
+    typedStmts.clear();
+}
+
+// ======= Type variables =======
+
+TypeChecker::TypeVar TypeChecker::fresh(Type type, bool numeric) {
+    vars.push_back(Var{static_cast<TypeVar>(vars.size()), type, numeric});
+    return vars.back().parent;
+}
+
+TypeChecker::TypeVar TypeChecker::find(TypeVar var) {
+    TypeVar root = var;
+    while (vars[root].parent != root) root = vars[root].parent;
+    while (vars[var].parent != root) var = std::exchange(vars[var].parent, root);
+    return root;
+}
+
+void TypeChecker::unify(TypeVar a, TypeVar b, const Token &token, const std::string &what) {
+    a = find(a);
+    b = find(b);
+    if (a == b) return;
+
+    Type type = vars[a].type == Type::Unknown ? vars[b].type : vars[a].type;
+    bool numeric = vars[a].numeric || vars[b].numeric;
+    bool clash = vars[b].type != Type::Unknown && vars[b].type != type;
+    if (numeric && type != Type::Unknown && type != Type::Int && type != Type::Float) clash = true;
+    if (clash) {
+        error(token, "Type mismatch in " + what + ": " + describe(a) + " and " + describe(b) + ".");
+        return;
+    }
+
+    vars[b].parent = a;
+    vars[a].type = type;
+    vars[a].numeric = numeric && type == Type::Unknown;
+}
+
+// The final type of a variable. Open integer literals, and the rare variable nothing constrains, are ints.
+Type TypeChecker::resolve(TypeVar var) {
+    Type type = vars[find(var)].type;
+    return type == Type::Unknown ? Type::Int : type;
+}
+
+Type TypeChecker::settle(TypeVar var) {
+    Var &root = vars[find(var)];
+    root.type = resolve(var);
+    root.numeric = false;
+    return root.type;
+}
+
+std::string TypeChecker::describe(TypeVar var) {
+    const Var &root = vars[find(var)];
+    if (root.type == Type::Unknown) return root.numeric ? "number" : "unknown";
+    return Types::name(root.type);
+}
+
+// ======= Helpers =======
+
+TypeChecker::TypeVar TypeChecker::infer(ExprPtr expr) {
+    TypeVar var = expr->accept(*this);
+    typedExprs.emplace_back(expr, var);
+    return var;
+}
+
+// A variable for the type an annotation names, or an open one without an annotation
+TypeChecker::TypeVar TypeChecker::annotated(ExprPtr annotation) {
+    if (!annotation) return fresh();
+
+    const Token &name = static_cast<TypeAnnotation &>(*annotation).name;
+    std::optional<Type> type = Types::fromName(name.lexeme);
+    if (!type) {
+        error(name, "Unknown type " + quoted(name) + ".");
+        return fresh();
+    }
+    annotation->type = *type;
+    return fresh(*type);
+}
+
+void TypeChecker::require(TypeVar var, Requirement requirement, const Token &token, std::string message) {
+    checks.push_back(Check{var, requirement, token, std::move(message)});
+}
+
+void TypeChecker::error(const Token &token, std::string message) {
+    diagnostics.push_back(Errors::at(token, std::move(message)));
+}
+
+void TypeChecker::declare(uint32_t slot, Binding binding) {
+    std::vector<Binding> &scope = scopes.back();
+    if (slot >= scope.size()) scope.resize(slot + 1);
+    scope[slot] = binding;
+}
+
+const TypeChecker::Binding &TypeChecker::lookup(const Expr &use) {
+    return scopes[scopes.size() - 1 - use.depth][use.slot];
+}
+
+// ======= Expressions =======
+
+TypeChecker::TypeVar TypeChecker::visitLiteralExpr(Literal &expr) {
+    return std::visit(
+        [&](auto &&val) -> TypeVar {
+            using T = std::decay_t<decltype(val)>;
+            if constexpr (std::is_same_v<T, int>)
+                return fresh(Type::Unknown, true);
+            else if constexpr (std::is_same_v<T, double>)
+                return fresh(Type::Float);
+            else if constexpr (std::is_same_v<T, bool>)
+                return fresh(Type::Bool);
+            else if constexpr (std::is_same_v<T, StringLiteral>)
+                return fresh(Type::String);
+            else
+                return fresh();
+        },
+        expr.value);
+}
+
+TypeChecker::TypeVar TypeChecker::visitBinaryExpr(Binary &expr) {
+    TypeVar left = infer(expr.left);
+    TypeVar right = infer(expr.right);
+    std::string op = quoted(expr.op);
+    unify(left, right, expr.op, "operands of " + op);
+
+    switch (expr.op.tokenType) {
+    case TokenType::PLUS:
+    case TokenType::MINUS:
+    case TokenType::STAR:
+    case TokenType::SLASH:
+        require(left, Requirement::Number, expr.op, "Operands of " + op + " must be numbers.");
+        return left;
+
+    case TokenType::LESS:
+    case TokenType::LESS_EQUAL:
+    case TokenType::GREATER:
+    case TokenType::GREATER_EQUAL:
+        require(left, Requirement::Number, expr.op, "Operands of " + op + " must be numbers.");
+        return fresh(Type::Bool);
+
+    default:
+        // == and != compare strings by their text
+        require(left, Requirement::Value, expr.op, "Operands of " + op + " cannot be void.");
+        return fresh(Type::Bool);
+    }
+}
+
+TypeChecker::TypeVar TypeChecker::visitLogicalExpr(Logical &expr) {
+    std::string message = "Operands of " + quoted(expr.op) + " must be numbers or booleans.";
+    require(infer(expr.left), Requirement::Scalar, expr.op, message);
+    require(infer(expr.right), Requirement::Scalar, expr.op, message);
+    return fresh(Type::Bool);
+}
+
+TypeChecker::TypeVar TypeChecker::visitUnaryExpr(Unary &expr) {
+    TypeVar right = infer(expr.right);
+    if (expr.op.tokenType == TokenType::MINUS) {
+        require(right, Requirement::Number, expr.op, "Operand of '-' must be a number.");
+        return right;
+    }
+    require(right, Requirement::Scalar, expr.op, "Operand of '!' must be a number or a boolean.");
+    return fresh(Type::Bool);
+}
+
+TypeChecker::TypeVar TypeChecker::visitGroupingExpr(Grouping &expr) { return infer(expr.expression); }
+
+TypeChecker::TypeVar TypeChecker::visitVariableExpr(Variable &expr) {
+    const Binding &binding = lookup(expr);
+    // Functions are not values: they can be called, but not stored, passed or printed
+    if (binding.signature) {
+        error(expr.name, "Function " + quoted(expr.name) + " can only be called.");
+        return fresh();
+    }
+    return binding.var;
+}
+
+TypeChecker::TypeVar TypeChecker::visitAssignExpr(Assign &expr) {
+    TypeVar value = infer(expr.value);
+    const Binding &binding = lookup(expr);
+    if (binding.signature) {
+        error(expr.name, "Cannot assign to function " + quoted(expr.name) + ".");
+        return value;
+    }
+
+    unify(binding.var, value, expr.name, "assignment to " + quoted(expr.name));
+    return binding.var;
+}
+
+TypeChecker::TypeVar TypeChecker::visitCallExpr(Call &expr) {
+    std::optional<size_t> index;
+    if (expr.callee->kind == NodeKind::Variable) {
+        index = lookup(*expr.callee).signature;
+        if (!index) error(expr.paren, "Can only call functions.");
+    } else {
+        infer(expr.callee);
+        error(expr.paren, "Can only call functions.");
+    }
+
+    if (!index) {
+        for (ExprPtr arg : expr.arguments) infer(arg);
+        return fresh();
+    }
+
+    Signature signature = signatures[*index];
+    size_t expected = signature.params.size();
+    size_t given = expr.arguments.size();
+    if (given < expected || (given > expected && !signature.variadic)) {
+        error(expr.paren,
+              "Expected " + std::to_string(expected) + " arguments but got " + std::to_string(given) + ".");
+    }
+
+    for (size_t i = 0; i < given; i++) {
+        TypeVar arg = infer(expr.arguments[i]);
+        if (i < expected) {
+            unify(signature.params[i], arg, tokenOf(*expr.arguments[i]), "argument " + std::to_string(i + 1));
+        } else {
+            require(arg, Requirement::Value, tokenOf(*expr.arguments[i]), "Cannot pass a void value.");
+        }
+    }
+    return signature.result;
+}
+
+TypeChecker::TypeVar TypeChecker::visitTypeAnnotationExpr(TypeAnnotation &expr) { return annotated(&expr); }
+
+// ======= Statements =======
+
+void TypeChecker::visitExpressionStmt(Expression &stmt) { infer(stmt.expression); }
+
+void TypeChecker::visitPrintStmt(Print &stmt) {
+    TypeVar value = infer(stmt.expression);
+    require(value, Requirement::Value, tokenOf(*stmt.expression), "Cannot print a void value.");
+}
+
+void TypeChecker::visitIfStmt(If &stmt) {
+    require(infer(stmt.condition), Requirement::Scalar, tokenOf(*stmt.condition),
+            "Condition must be a number or a boolean.");
+    stmt.thenBranch->accept(*this);
+    if (stmt.elseBranch) stmt.elseBranch->accept(*this);
+}
+
+void TypeChecker::visitWhileStmt(While &stmt) {
+    require(infer(stmt.condition), Requirement::Scalar, tokenOf(*stmt.condition),
+            "Condition must be a number or a boolean.");
+    stmt.body->accept(*this);
+}
+
+void TypeChecker::visitLetStmt(Let &stmt) {
+    TypeVar var = annotated(stmt.annotation);
+    if (stmt.initializer) {
+        unify(var, infer(stmt.initializer), stmt.name, "initializer of " + quoted(stmt.name));
+    }
+    require(var, Requirement::Value, stmt.name, "Variable " + quoted(stmt.name) + " cannot be void.");
+
+    typedStmts.emplace_back(&stmt, var);
+    // Declared after the initializer, which still sees an outer variable of the same name
+    declare(stmt.slot, Binding{var, std::nullopt});
+}
+
+void TypeChecker::visitBlockStmt(Block &stmt) {
+    beginScope();
+    for (StmtPtr statement : stmt.statements) statement->accept(*this);
+    endScope();
+}
+
+void TypeChecker::visitFunctionStmt(Function &stmt) {
+    Signature signature;
+    for (Let &param : stmt.params) {
+        TypeVar var = annotated(param.annotation);
+        require(var, Requirement::Value, param.name, "Parameter " + quoted(param.name) + " cannot be void.");
+        typedStmts.emplace_back(&param, var);
+        signature.params.push_back(var);
+    }
+    signature.result = annotated(stmt.returnAnnotation);
+    typedStmts.emplace_back(&stmt, signature.result);
+
+    // Declared before the body so that the function can call itself
+    signatures.push_back(signature);
+    declare(stmt.slot, Binding{signature.result, signatures.size() - 1});
+
+    beginScope();
+    for (size_t i = 0; i < stmt.params.size(); i++) {
+        declare(stmt.params[i].slot, Binding{signature.params[i], std::nullopt});
+    }
+    functions.push_back(FunctionContext{signature.result, false});
+    for (StmtPtr statement : stmt.body) statement->accept(*this);
+
+    if (!functions.back().returnsValue) {
+        Type declared = vars[find(signature.result)].type;
+        if (declared != Type::Unknown && declared != Type::Void) {
+            error(stmt.name, "Function " + quoted(stmt.name) + " must return a value of type " +
+                                 Types::name(declared) + ".");
+        } else {
+            unify(signature.result, fresh(Type::Void), stmt.name, "result of " + quoted(stmt.name));
+        }
+    }
+    functions.pop_back();
+    endScope();
+}
+
+void TypeChecker::visitClassStmt(Class &) {}
+
+void TypeChecker::visitReturnStmt(Return &stmt) {
+    if (functions.empty()) {
+        error(stmt.keyword, "Can't return from top-level code.");
+        if (stmt.value) infer(stmt.value);
+        return;
+    }
+
+    if (!stmt.value) {
+        unify(functions.back().result, fresh(Type::Void), stmt.keyword, "return value");
+        return;
+    }
+
+    TypeVar value = infer(stmt.value);
+    require(value, Requirement::Value, stmt.keyword, "Cannot return a void value.");
+    unify(functions.back().result, value, stmt.keyword, "return value");
+    functions.back().returnsValue = true;
+}
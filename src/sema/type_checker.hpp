@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "ast.hpp"
+#include "errors.hpp"
+#include "program.hpp"
+
+// Infers the static type of every expression, variable, parameter and function result of a program, checks
+// that they are used consistently, and writes them into the nodes (Expr::type, Stmt::declaredType) so that
+// codegen can use native machine types instead of guessing from LLVM values.
+//
+// Inference is monomorphic, in the style of Hindley-Milner without generalization: every variable,
+// parameter, function result and expression gets a type variable, and each use unifies the variables that
+// must agree. An integer literal stays open until a use fixes it to int or float; whatever is still open
+// once the whole program has been seen defaults to int. Type annotations only pin a variable down.
+//
+// Names must have been resolved (see Resolver) without errors.
+class TypeChecker {
+  public:
+    void check(Program &program);
+    // Checks one entry of an interactive session, after the Resolver's resolveEntry. Its top level keeps the
+    // bindings of the entries checked before. Every type is settled once its entry is checked, so that a
+    // later entry cannot change the type of code that was already compiled.
+    void checkEntry(Program &entry);
+
+    // Type errors, in the order they were found. Nodes are typed even when there are some, but codegen
+    // should not run on them.
+    const std::vector<Diagnostic> &getDiagnostics() const { return diagnostics; }
+    bool hadError() const { return !diagnostics.empty(); }
+
+    using TypeVar = uint32_t;
+
+    TypeVar visitLiteralExpr(Literal &expr);
+    TypeVar visitBinaryExpr(Binary &expr);
+    TypeVar visitLogicalExpr(Logical &expr);
+    TypeVar visitUnaryExpr(Unary &expr);
+    TypeVar visitGroupingExpr(Grouping &expr);
+    TypeVar visitVariableExpr(Variable &expr);
+    TypeVar visitAssignExpr(Assign &expr);
+    TypeVar visitCallExpr(Call &expr);
+    TypeVar visitTypeAnnotationExpr(TypeAnnotation &expr);
+
+    void visitExpressionStmt(Expression &stmt);
+    void visitPrintStmt(Print &stmt);
+    void visitIfStmt(If &stmt);
+    void visitWhileStmt(While &stmt);
+    void visitLetStmt(Let &stmt);
+    void visitBlockStmt(Block &stmt);
+    void visitFunctionStmt(Function &stmt);
+    void visitClassStmt(Class &stmt);
+    void visitReturnStmt(Return &stmt);
+
+  private:
+    // Union-find node. Only a root's type and numeric flag are meaningful.
+    struct Var {
+        TypeVar parent;
+        Type type;    // Unknown while nothing fixed it
+        bool numeric; // An open integer literal: may still become int or float
+    };
+
+    struct Signature {
+        std::vector<TypeVar> params;
+        TypeVar result;
+        bool variadic = false; // Extra arguments of any non-void type, as for printf
+    };
+
+    // What a name in scope refers to: a variable, or a function if signature is set
+    struct Binding {
+        TypeVar var = 0;
+        std::optional<size_t> signature;
+    };
+
+    struct FunctionContext {
+        TypeVar result;
+        bool returnsValue = false;
+    };
+
+    // Checks that can only be decided once every use has been seen, e.g. whether an open literal is numeric
+    enum class Requirement : uint8_t { Value, Number, Scalar };
+    struct Check {
+        TypeVar var;
+        Requirement requirement;
+        Token token;
+        std::string message;
+    };
+
+    std::vector<Var> vars;
+    std::vector<Signature> signatures;
+    std::vector<std::vector<Binding>> scopes; // Indexed by the slots of the Resolver, which runs first
+    std::vector<FunctionContext> functions;
+    std::vector<Check> checks;
+    std::vector<std::pair<Expr *, TypeVar>> typedExprs;
+    std::vector<std::pair<Stmt *, TypeVar>> typedStmts;
+    std::vector<Diagnostic> diagnostics;
+
+    TypeVar fresh(Type type = Type::Unknown, bool numeric = false);
+    TypeVar find(TypeVar var);
+    void unify(TypeVar a, TypeVar b, const Token &token, const std::string &what);
+    Type resolve(TypeVar var);
+    // Fixes a variable to its final type
+    Type settle(TypeVar var);
+    std::string describe(TypeVar var);
+
+    TypeVar infer(ExprPtr expr);
+    TypeVar annotated(ExprPtr annotation);
+    void require(TypeVar var, Requirement requirement, const Token &token, std::string message);
+    void error(const Token &token, std::string message);
+
+    void declare(uint32_t slot, Binding binding);
+    const Binding &lookup(const Expr &use);
+    void beginScope() { scopes.emplace_back(); }
+    void endScope() { scopes.pop_back(); }
+    void declareBuiltins();
+    // Runs the deferred checks and writes the types into the nodes
+    void finish();
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdio>
+
+// The tests' one assertion: a failed check is reported and counted, and the test goes on, so that a run
+// shows every failure at once. main() returns finish().
+inline int failures = 0;
+
+#define CHECK(condition)                                                                                     \
+    do {                                                                                                     \
+        if (!(condition)) {                                                                                  \
+            std::fprintf(stderr, "%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, __func__, #condition); \
+            failures++;                                                                                      \
+        }                                                                                                    \
+    } while (false)
+
+inline int finish() {
+    if (failures) std::fprintf(stderr, "%d checks failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,201 @@
+// Checks IncrementalParser against full parses: after every edit, the program, its tokens (down to offsets,
+// lines and token indices) and its diagnostics must be exactly what a full parse of the edited text gives.
+//
+// Usage: marbl_incremental_test
+
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include "binary_io.hpp"
+#include "check.hpp"
+#include "errors.hpp"
+#include "flat_ast.hpp"
+#include "incremental.hpp"
+#include "parser.hpp"
+#include "printer.hpp"
+#include "source.hpp"
+
+namespace {
+const char *SOURCE = "let a = 1;\n"
+                     "fn f(x) {\n"
+                     "    return x + a;\n"
+                     "}\n"
+                     "print f(2);\n"
+                     "let s = \"text\";\n"
+                     "while (a < 3) { a = a + 1; }\n";
+constexpr size_t DECLARATIONS = 5;
+
+// Everything a later pass or the parse cache could look at, in one comparable string
+std::string snapshot(Program &program, const std::vector<Diagnostic> &diagnostics) {
+    std::ostringstream out;
+    AstDump::print(out, program, AstFormat::Json);
+    Errors::print(out, diagnostics);
+
+    BinaryWriter writer;
+    program.tokens->write(writer);
+    FlatAst::build(program).write(writer);
+    out << writer.getBuffer();
+    return out.str();
+}
+
+// Whether the incremental result matches a full parse of the current text
+bool matchesFullParse(IncrementalParser &incremental) {
+    Parser parser{incremental.getFileId()};
+    Program program = parser.parse();
+    return snapshot(incremental.getProgram(), incremental.getDiagnostics()) ==
+           snapshot(program, parser.getDiagnostics());
+}
+
+// Replaces the first occurrence of `find` after `from` with `replacement`
+bool replace(IncrementalParser &parser, std::string_view find, std::string replacement, size_t from = 0) {
+    size_t begin = parser.getText().find(find, from);
+    if (begin == std::string_view::npos) return false;
+    return parser.apply(TextEdit{begin, begin + find.size(), std::move(replacement)});
+}
+
+IncrementalParser start() { return IncrementalParser{Sources::add("test.mrbl", SOURCE)}; }
+
+// ======= Tests =======
+
+void editInsideDeclaration() {
+    IncrementalParser parser = start();
+    CHECK(replace(parser, "x + a", "x * a - 1"));
+    CHECK(parser.getReparsed() == 1);
+    CHECK(matchesFullParse(parser));
+}
+
+void editChangingLineCount() {
+    IncrementalParser parser = start();
+    std::string original = snapshot(parser.getProgram(), parser.getDiagnostics());
+
+    // Declarations after the edit move down two lines, then back up
+    CHECK(replace(parser, "{\n", "{\n\n\n"));
+    CHECK(parser.getReparsed() == 1);
+    CHECK(matchesFullParse(parser));
+
+    CHECK(replace(parser, "{\n\n\n", "{\n"));
+    CHECK(parser.getReparsed() == 1);
+    CHECK(matchesFullParse(parser));
+
+    // Back to the original text, and so to the original lines, offsets and token indices
+    CHECK(parser.getText() == SOURCE);
+    CHECK(snapshot(parser.getProgram(), parser.getDiagnostics()) == original);
+
+    // A line break inside a token-free stretch between declarations
+    CHECK(replace(parser, "}\nprint", "}\n\n// comment\nprint"));
+    CHECK(matchesFullParse(parser));
+}
+
+void editAcrossDeclarations() {
+    IncrementalParser parser = start();
+
+    // Merges the end of the first declaration with the middle of the second one
+    std::string_view text = parser.getText();
+    size_t begin = text.find("1;");
+    size_t end = text.find("x + a");
+    CHECK(parser.apply(TextEdit{begin, end, "2 + "}));
+    CHECK(matchesFullParse(parser));
+
+    // And splits them again
+    CHECK(replace(parser, "2 + ", "1;\nfn f(x) {\n    return "));
+    CHECK(matchesFullParse(parser));
+    CHECK(parser.getText() == SOURCE);
+    CHECK(parser.getProgram().statements.size() == DECLARATIONS);
+
+    // Removing a whole declaration, then putting it back
+    CHECK(replace(parser, "print f(2);\n", ""));
+    CHECK(matchesFullParse(parser));
+    CHECK(parser.getProgram().statements.size() == DECLARATIONS - 1);
+    CHECK(replace(parser, "let s", "print f(2);\nlet s"));
+    CHECK(matchesFullParse(parser));
+}
+
+void unterminatedStrings() {
+    IncrementalParser parser = start();
+
+    // Without its closing quote, the string runs to the end of the file
+    CHECK(replace(parser, "\"text\"", "\"text"));
+    CHECK(matchesFullParse(parser));
+    CHECK(!parser.getDiagnostics().empty());
+
+    // A later edit can close it again, which the declaration holding the quote must see
+    CHECK(replace(parser, "a + 1;", "a + 1; \""));
+    CHECK(matchesFullParse(parser));
+    CHECK(replace(parser, "\"text", "\"text\""));
+    CHECK(matchesFullParse(parser));
+
+    // An open quote in the first declaration swallows every declaration after it
+    CHECK(replace(parser, "let a = 1;", "let a = \"1;"));
+    CHECK(matchesFullParse(parser));
+    CHECK(replace(parser, "\"1;", "1;"));
+    CHECK(matchesFullParse(parser));
+
+    // A string ending in an escaped quote can still grow up to a later quote
+    CHECK(replace(parser, "\"text\"", "\"text\\\""));
+    CHECK(matchesFullParse(parser));
+    CHECK(replace(parser, "\"text\\\"", "\"text\""));
+    CHECK(matchesFullParse(parser));
+}
+
+void syntaxErrors() {
+    IncrementalParser parser = start();
+    CHECK(replace(parser, "print f(2);", "print f(2;"));
+    CHECK(matchesFullParse(parser));
+    CHECK(parser.getDiagnostics().size() == 1);
+    CHECK(parser.getProgram().statements.size() == DECLARATIONS - 1);
+
+    CHECK(replace(parser, "print f(2;", "print f(2);"));
+    CHECK(matchesFullParse(parser));
+    CHECK(parser.getDiagnostics().empty());
+}
+
+// Once more declarations were reparsed than the file has, the next edit parses the whole file again
+void fullReparseFallback() {
+    IncrementalParser parser = start();
+    bool fellBack = false;
+    for (int i = 0; i < 2 * static_cast<int>(DECLARATIONS); i++) {
+        CHECK(replace(parser, "a < " + std::to_string(i + 3), "a < " + std::to_string(i + 4)));
+        CHECK(matchesFullParse(parser));
+        if (parser.getReparsed() == DECLARATIONS) fellBack = true;
+    }
+    CHECK(fellBack);
+}
+
+// Editing a different declaration each time keeps many versions of the text alive, until the declarations
+// are moved over to the current one
+void manyVersions() {
+    std::string source;
+    for (int i = 0; i < 12; i++) source += "let v" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+    IncrementalParser parser{Sources::add("versions.mrbl", source)};
+
+    for (int i = 0; i < 12; i++) {
+        std::string name = "v" + std::to_string(i);
+        CHECK(replace(parser, name + " =", name + "x ="));
+        CHECK(parser.getReparsed() == 1);
+        CHECK(matchesFullParse(parser));
+    }
+}
+
+void invalidEdits() {
+    IncrementalParser parser = start();
+    size_t size = parser.getText().size();
+    CHECK(!parser.apply(TextEdit{size, size + 1, ""}));
+    CHECK(!parser.apply(TextEdit{2, 1, ""}));
+    CHECK(parser.getText() == SOURCE);
+    CHECK(matchesFullParse(parser));
+}
+} // namespace
+
+int main() {
+    editInsideDeclaration();
+    editChangingLineCount();
+    editAcrossDeclarations();
+    unterminatedStrings();
+    syntaxErrors();
+    fullReparseFallback();
+    manyVersions();
+    invalidEdits();
+
+    return finish();
+}
@@ -0,0 +1,84 @@
+// Checks what ConstantFolder and DeadCodeEliminator leave of small programs, after the resolver and the type
+// checker ran on them as the compiler runs them.
+//
+// Usage: marbl_opt_test
+
+#include <sstream>
+#include <string>
+
+#include "check.hpp"
+#include "constant_folder.hpp"
+#include "dead_code_eliminator.hpp"
+#include "parser.hpp"
+#include "printer.hpp"
+#include "resolver.hpp"
+#include "source.hpp"
+#include "type_checker.hpp"
+
+namespace {
+// The text dump of `source` once folded and cleaned up, or its diagnostics if it has some
+std::string optimize(const std::string &source) {
+    std::ostringstream out;
+    Parser parser{Sources::add("opt.mrbl", source)};
+    Program program = parser.parse();
+    Resolver resolver;
+    TypeChecker checker;
+    Errors::print(out, parser.getDiagnostics());
+    if (!parser.getDiagnostics().empty()) return out.str();
+    resolver.resolve(program);
+    Errors::print(out, resolver.getDiagnostics());
+    if (resolver.hadError()) return out.str();
+    checker.check(program);
+    Errors::print(out, checker.getDiagnostics());
+    if (checker.hadError()) return out.str();
+
+    ConstantFolder folder;
+    folder.fold(program);
+    DeadCodeEliminator eliminator;
+    eliminator.eliminate(program);
+    AstDump::print(out, program, AstFormat::Text);
+    return out.str();
+}
+
+// ======= Tests =======
+
+void arithmetic() {
+    CHECK(optimize("print 1 + 2 * 3;") == "stmt: print(7);\n");
+    CHECK(optimize("print 1.0 + 2.0;") == "stmt: print(3);\n");
+    CHECK(optimize("let x: float = 1 / 4; print x;") == "stmt: print(0.25);\n");
+    // Ints wrap as they do at run time
+    CHECK(optimize("let c = 2147483647 + 1; print c;") == "stmt: print(-2147483648);\n");
+    // Left to fail at run time rather than folded into a value
+    CHECK(optimize("print 7 / 0;") == "stmt: print(( 7 / 0 ));\n");
+}
+
+void comparisons() {
+    CHECK(optimize("print \"a\" == \"a\";") == "stmt: print(true);\n");
+    CHECK(optimize("print \"a\" != \"a\";") == "stmt: print(false);\n");
+    CHECK(optimize("print 2 < 1;") == "stmt: print(false);\n");
+}
+
+void constantBranches() {
+    CHECK(optimize("if (1 < 2) print \"y\"; else print \"n\";") == "stmt: print(\"y\");\n");
+    CHECK(optimize("if (2 < 1) print \"y\"; else print \"n\";") == "stmt: print(\"n\");\n");
+    CHECK(optimize("while (false) print 1;").empty());
+}
+
+void deadCode() {
+    // A function that is never called is dropped, one that is is kept
+    CHECK(optimize("fn f(x) { return x; } fn g() { return 1; } print f(2);") ==
+          "stmt: fn f(x) {return x;}\nstmt: print(f(2));\n");
+    // A variable that is assigned to is not a constant
+    CHECK(optimize("let n = 1; n = n + 1; print n;") ==
+          "stmt: let n = 1;\nstmt: n = ( n + 1 );\nstmt: print(n);\n");
+}
+} // namespace
+
+int main() {
+    arithmetic();
+    comparisons();
+    constantBranches();
+    deadCode();
+
+    return finish();
+}
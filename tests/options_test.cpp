@@ -0,0 +1,137 @@
+// Checks CommandLine::parse: the options it accepts in each of their spellings, and the command lines it
+// rejects instead of compiling something else than what was asked for.
+//
+// Usage: marbl_options_test
+
+#include <initializer_list>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "options.hpp"
+
+namespace {
+// `args` parsed as the arguments after the program's name
+std::optional<Options> parse(std::initializer_list<std::string> args, std::string *errors = nullptr) {
+    std::vector<std::string> strings = {"marbl"};
+    strings.insert(strings.end(), args);
+    std::vector<char *> argv;
+    for (std::string &string : strings) argv.push_back(string.data());
+    argv.push_back(nullptr);
+
+    std::ostringstream err;
+    std::optional<Options> options = CommandLine::parse(static_cast<int>(strings.size()), argv.data(), err);
+    if (errors) *errors = err.str();
+    return options;
+}
+
+// ======= Tests =======
+
+void defaults() {
+    std::optional<Options> options = parse({"a.mrbl"});
+    CHECK(options);
+    if (!options) return;
+    CHECK(!options->run);
+    CHECK(options->jobs == 0);
+    CHECK(!options->cacheDir && !options->dumpAst && !options->output);
+    CHECK(!options->emitIr);
+    CHECK(options->emit == Emit::Obj);
+    CHECK(options->optLevel == llvm::OptimizationLevel::O0);
+    CHECK(options->cpu == "generic");
+    CHECK(options->inputs == std::vector<std::string>{"a.mrbl"});
+}
+
+void inputs() {
+    std::optional<Options> options = parse({"a.mrbl", "-O1", "b.mrbl"});
+    CHECK(options && options->inputs == (std::vector<std::string>{"a.mrbl", "b.mrbl"}));
+
+    options = parse({"run", "a.mrbl"});
+    CHECK(options && options->run && options->inputs.size() == 1);
+
+    CHECK(!parse({}));
+    CHECK(!parse({"run"}));
+    CHECK(!parse({"-O2"}));
+    CHECK(!parse({"run", "a.mrbl", "b.mrbl"}));
+    CHECK(!parse({"-o", "out", "a.mrbl", "b.mrbl"}));
+}
+
+void jobs() {
+    std::optional<Options> options = parse({"-j", "4", "a.mrbl"});
+    CHECK(options && options->jobs == 4);
+    options = parse({"-j8", "a.mrbl"});
+    CHECK(options && options->jobs == 8);
+
+    std::string errors;
+    CHECK(!parse({"-j0", "a.mrbl"}, &errors));
+    CHECK(errors == "Invalid job count '0'\n");
+    CHECK(!parse({"-jx", "a.mrbl"}));
+    CHECK(!parse({"-j4x", "a.mrbl"}));
+    CHECK(!parse({"-j", "-1", "a.mrbl"}));
+    CHECK(!parse({"a.mrbl", "-j"}));
+}
+
+void optimizationLevels() {
+    std::optional<Options> options = parse({"-O3", "a.mrbl"});
+    CHECK(options && options->optLevel == llvm::OptimizationLevel::O3);
+    options = parse({"-O", "a.mrbl"});
+    CHECK(options && options->optLevel == llvm::OptimizationLevel::O2);
+    options = parse({"-Oz", "a.mrbl"});
+    CHECK(options && options->optLevel == llvm::OptimizationLevel::Oz);
+
+    std::string errors;
+    CHECK(!parse({"-O4", "a.mrbl"}, &errors));
+    CHECK(errors == "Unknown optimization level '-O4'\n");
+}
+
+void output() {
+    std::optional<Options> options = parse({"-o", "out", "a.mrbl"});
+    CHECK(options && options->output == "out");
+    options = parse({"-oout", "a.mrbl"});
+    CHECK(options && options->output == "out");
+
+    CHECK(!parse({"-o=out", "a.mrbl"}));
+    CHECK(!parse({"a.mrbl", "-o"}));
+}
+
+void emitAndDump() {
+    std::optional<Options> options = parse({"--emit=exe", "a.mrbl"});
+    CHECK(options && options->emit == Emit::Exe);
+    options = parse({"--emit", "ll", "a.mrbl"});
+    CHECK(options && options->emit == Emit::Ll);
+    options = parse({"--emit-ir", "a.mrbl"});
+    CHECK(options && options->emitIr && options->emit == Emit::Obj);
+
+    options = parse({"--dump-ast", "a.mrbl"});
+    CHECK(options && options->dumpAst == AstFormat::Text);
+    options = parse({"--dump-ast=sexpr", "a.mrbl"});
+    CHECK(options && options->dumpAst == AstFormat::Sexpr);
+
+    std::string errors;
+    CHECK(!parse({"--emit=elf", "a.mrbl"}, &errors));
+    CHECK(errors == "Unknown output kind 'elf'\n");
+    CHECK(!parse({"--dump-ast=xml", "a.mrbl"}, &errors));
+    CHECK(errors == "Unknown AST format 'xml'\n");
+}
+
+void unknownOptions() {
+    std::string errors;
+    CHECK(!parse({"-v", "a.mrbl"}, &errors));
+    CHECK(errors == "Unknown option '-v'\n");
+    CHECK(!parse({"a.mrbl", "-x"}));
+    CHECK(!parse({"--emti=exe", "a.mrbl"}));
+    CHECK(!parse({"--help", "a.mrbl"}));
+}
+} // namespace
+
+int main() {
+    defaults();
+    inputs();
+    jobs();
+    optimizationLevels();
+    output();
+    emitAndDump();
+    unknownOptions();
+
+    return finish();
+}
@@ -0,0 +1,151 @@
+// Checks ParseCache: a hit must give back exactly the program a parse gives, and an entry that does not
+// belong to the text being loaded, or that was damaged on disk, must miss rather than be trusted.
+//
+// Usage: marbl_parse_cache_test
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include "binary_io.hpp"
+#include "check.hpp"
+#include "flat_ast.hpp"
+#include "parse_cache.hpp"
+#include "parser.hpp"
+#include "printer.hpp"
+#include "source.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+const char *SOURCE = "let a = 1;\n"
+                     "fn f(x) {\n"
+                     "    return x + a;\n"
+                     "}\n"
+                     "print f(2.5);\n"
+                     "let s = \"text\";\n"
+                     "while (a < 3) { a = a + 1; }\n";
+
+// A fresh, empty directory for one test's cache
+fs::path emptyDirectory(const std::string &name) {
+    fs::path directory = fs::temp_directory_path() / ("marbl-parse-cache-test-" + name);
+    fs::remove_all(directory);
+    return directory;
+}
+
+// Everything the cache must keep, in one comparable string
+std::string snapshot(Program &program) {
+    std::ostringstream out;
+    AstDump::print(out, program, AstFormat::Json);
+
+    BinaryWriter writer;
+    program.tokens->write(writer);
+    FlatAst::build(program).write(writer);
+    out << writer.getBuffer();
+    return out.str();
+}
+
+// Parses the file and stores its program in `cache`, returning its snapshot
+std::string parseAndStore(const ParseCache &cache, FileId fileId) {
+    Parser parser{fileId};
+    Program program = parser.parse();
+    CHECK(parser.getDiagnostics().empty());
+    cache.store(fileId, program);
+    return snapshot(program);
+}
+
+// The directory's only entry
+fs::path onlyEntry(const fs::path &directory) {
+    fs::directory_iterator entries(directory);
+    fs::path path = entries->path();
+    CHECK(++entries == fs::directory_iterator());
+    return path;
+}
+
+std::string readFile(const fs::path &path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+void writeFile(const fs::path &path, const std::string &content) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << content;
+}
+
+// ======= Tests =======
+
+void roundTrip() {
+    ParseCache cache(emptyDirectory("round-trip"));
+    FileId stored = Sources::add("round-trip.mrbl", SOURCE);
+    std::string parsed = parseAndStore(cache, stored);
+    std::optional<Program> loaded = cache.load(stored);
+    CHECK(loaded);
+    if (loaded) CHECK(snapshot(*loaded) == parsed);
+
+    // Another file with the same text, as after a restart: its tokens are that file's
+    FileId again = Sources::add("again.mrbl", SOURCE);
+    loaded = cache.load(again);
+    CHECK(loaded);
+    Parser parser{again};
+    Program program = parser.parse();
+    if (loaded) CHECK(snapshot(*loaded) == snapshot(program));
+}
+
+void editedTextMisses() {
+    ParseCache cache(emptyDirectory("edited"));
+    parseAndStore(cache, Sources::add("edited.mrbl", SOURCE));
+
+    std::string edited = SOURCE;
+    edited.replace(edited.find("2.5"), 3, "3.5");
+    CHECK(!cache.load(Sources::add("edited.mrbl", edited)));
+}
+
+// As if the entries of two texts had the same name: the entry of one must not be taken for the other
+void collisionMisses() {
+    fs::path first = emptyDirectory("collision-a");
+    fs::path second = emptyDirectory("collision-b");
+    std::string other = "print 1 + 2;\n";
+    parseAndStore(ParseCache(first), Sources::add("a.mrbl", SOURCE));
+    parseAndStore(ParseCache(second), Sources::add("b.mrbl", other));
+
+    writeFile(onlyEntry(second), readFile(onlyEntry(first)));
+    CHECK(!ParseCache(second).load(Sources::add("b.mrbl", other)));
+    CHECK(ParseCache(first).load(Sources::add("a.mrbl", SOURCE)));
+}
+
+void damagedEntriesMiss() {
+    fs::path directory = emptyDirectory("damaged");
+    ParseCache cache(directory);
+    parseAndStore(cache, Sources::add("damaged.mrbl", SOURCE));
+    fs::path path = onlyEntry(directory);
+    std::string entry = readFile(path);
+
+    // A flipped bit in the header, in the copy of the text and in the body
+    for (size_t offset : {size_t{0}, entry.find("fn f"), entry.size() - 1}) {
+        std::string damaged = entry;
+        damaged[offset] ^= 1;
+        writeFile(path, damaged);
+        CHECK(!cache.load(Sources::add("damaged.mrbl", SOURCE)));
+    }
+
+    // Cut short anywhere, including inside the header
+    for (size_t size : {size_t{0}, size_t{4}, entry.size() / 2, entry.size() - 1}) {
+        writeFile(path, entry.substr(0, size));
+        CHECK(!cache.load(Sources::add("damaged.mrbl", SOURCE)));
+    }
+
+    writeFile(path, entry);
+    CHECK(cache.load(Sources::add("damaged.mrbl", SOURCE)));
+}
+} // namespace
+
+int main() {
+    roundTrip();
+    editedTextMisses();
+    collisionMisses();
+    damagedEntriesMiss();
+
+    return finish();
+}
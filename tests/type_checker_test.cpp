@@ -0,0 +1,102 @@
+// Checks TypeChecker: the types it infers for unannotated code, and the errors it reports for code that
+// cannot be typed.
+//
+// Usage: marbl_type_checker_test
+
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "parser.hpp"
+#include "resolver.hpp"
+#include "source.hpp"
+#include "type_checker.hpp"
+
+namespace {
+// A program that parsed and resolved without errors, and was type checked
+struct Checked {
+    Program program;
+    std::vector<std::string> errors; // The type checker's messages
+};
+
+Checked check(const std::string &source) {
+    Parser parser{Sources::add("types.mrbl", source)};
+    Checked checked{parser.parse(), {}};
+    CHECK(parser.getDiagnostics().empty());
+    Resolver resolver;
+    resolver.resolve(checked.program);
+    CHECK(!resolver.hadError());
+
+    TypeChecker checker;
+    checker.check(checked.program);
+    for (const Diagnostic &diagnostic : checker.getDiagnostics()) {
+        checked.errors.push_back(diagnostic.message);
+    }
+    return checked;
+}
+
+// The one error `source` has
+std::string errorOf(const std::string &source) {
+    std::vector<std::string> errors = check(source).errors;
+    CHECK(errors.size() == 1);
+    return errors.empty() ? "" : errors[0];
+}
+
+// The declared type of the `index`th top-level statement
+Type declaredType(const std::string &source, size_t index) {
+    Checked checked = check(source);
+    CHECK(checked.errors.empty());
+    CHECK(index < checked.program.statements.size());
+    return index < checked.program.statements.size() ? checked.program.statements[index]->declaredType
+                                                     : Type::Unknown;
+}
+
+// ======= Tests =======
+
+void inference() {
+    CHECK(declaredType("let a = 1;", 0) == Type::Int);
+    CHECK(declaredType("let a = 1.5;", 0) == Type::Float);
+    CHECK(declaredType("let a = \"s\";", 0) == Type::String);
+    CHECK(declaredType("let a = 1 < 2;", 0) == Type::Bool);
+    CHECK(declaredType("let x: float = 1;", 0) == Type::Float);
+    // A parameter takes the type of the arguments, and the return value follows
+    CHECK(declaredType("fn f(x) { return x + 1; } print f(2.5);", 0) == Type::Float);
+    CHECK(declaredType("fn f(x) { return x + 1; } print f(2);", 0) == Type::Int);
+    CHECK(declaredType("fn f() { print 1; } f();", 0) == Type::Void);
+}
+
+void mismatches() {
+    CHECK(errorOf("print 1 + \"s\";") == "Type mismatch in operands of '+': number and string.");
+    CHECK(errorOf("let a = 1; a = \"s\";") == "Type mismatch in assignment to 'a': number and string.");
+    CHECK(errorOf("fn f(x) { return x + 1; } print f(\"s\");") ==
+          "Type mismatch in argument 1: number and string.");
+    CHECK(errorOf("let x: float = 1; let y: int = x;") ==
+          "Type mismatch in initializer of 'y': int and float.");
+    CHECK(errorOf("let a: int = 1; let b = a + 2.5;") == "Type mismatch in operands of '+': int and float.");
+}
+
+void requirements() {
+    CHECK(errorOf("print -\"s\";") == "Operand of '-' must be a number.");
+    CHECK(errorOf("if (\"s\") print 1;") == "Condition must be a number or a boolean.");
+    CHECK(errorOf("print \"a\" < \"b\";") == "Operands of '<' must be numbers.");
+    CHECK(errorOf("fn f() { print 1; } print f();") == "Cannot print a void value.");
+    CHECK(errorOf("fn f() { print 1; } print f() == f();") == "Operands of '==' cannot be void.");
+    CHECK(errorOf("fn f() { return 1; } let g = f;") == "Function 'f' can only be called.");
+}
+
+void validPrograms() {
+    CHECK(check("print \"a\" == \"b\"; print \"a\" != \"b\";").errors.empty());
+    CHECK(check("let a = 1; while (a < 3) { a = a + 1; } print a;").errors.empty());
+    CHECK(check("fn fib(n) { if (n < 2) return n; return fib(n - 1) + fib(n - 2); } print fib(10);")
+              .errors.empty());
+}
+} // namespace
+
+int main() {
+    inference();
+    mismatches();
+    requirements();
+    validPrograms();
+
+    return finish();
+}